@@ -2,6 +2,7 @@
 #pragma once
 
 #include <functional>
+#include <stdexcept>
 
 using namespace std;
 
@@ -100,6 +101,14 @@ public:
         return data[index];
     }
 
+    void removeAt(size_t index) {
+        if (index >= size) throw std::out_of_range("removeAt: index out of range");
+        for (size_t i = index + 1; i < size; ++i) {
+            data[i - 1] = std::move(data[i]);
+        }
+        data[--size] = T();
+    }
+
     size_t getSize() const {
         return size;
     }
@@ -0,0 +1,69 @@
+// adt/Bitmap.hpp
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "Array.hpp"
+
+using namespace std;
+
+// Growable set of bit positions, stored as 64-bit words.
+class Bitmap {
+private:
+    Array<uint64_t> words;
+    size_t bits = 0;
+
+public:
+    void set(size_t index) {
+        while (words.getSize() <= index / 64) {
+            words.append(0);
+        }
+        uint64_t mask = uint64_t(1) << (index % 64);
+        if (!(words.at(index / 64) & mask)) {
+            words.at(index / 64) |= mask;
+            bits++;
+        }
+    }
+
+    bool test(size_t index) const {
+        if (index / 64 >= words.getSize()) return false;
+        return (words.at(index / 64) >> (index % 64)) & 1;
+    }
+
+    size_t count() const {
+        return bits;
+    }
+
+    bool empty() const {
+        return bits == 0;
+    }
+
+    void clear() {
+        words = Array<uint64_t>();
+        bits = 0;
+    }
+
+    // Little-endian words, for storing the bitmap in a file.
+    string serialize() const {
+        string out;
+        for (size_t i = 0; i < words.getSize(); ++i) {
+            for (int b = 0; b < 8; ++b) {
+                out += static_cast<char>((words.at(i) >> (8 * b)) & 0xFF);
+            }
+        }
+        return out;
+    }
+
+    static Bitmap deserialize(const string& data) {
+        Bitmap bitmap;
+        for (size_t i = 0; i + 8 <= data.size(); i += 8) {
+            uint64_t word = 0;
+            for (int b = 0; b < 8; ++b) {
+                word |= static_cast<uint64_t>(static_cast<unsigned char>(data[i + b])) << (8 * b);
+            }
+            bitmap.words.append(word);
+            bitmap.bits += __builtin_popcountll(word);
+        }
+        return bitmap;
+    }
+};
@@ -0,0 +1,108 @@
+// adt/BloomFilter.hpp
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <string>
+#include <string_view>
+#include "Array.hpp"
+
+using namespace std;
+
+// Set of byte strings that may answer "maybe" for values never added but
+// never "no" for one that was. Sized for an expected number of values and
+// false-positive rate; the probes are derived from one 64-bit hash by
+// double hashing.
+class BloomFilter {
+private:
+    Array<uint64_t> words;
+    size_t hashes = 0;
+
+    static uint64_t mix(uint64_t h) {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    static uint64_t hash(string_view value) {
+        uint64_t h = 1469598103934665603ULL;
+        for (char c : value) {
+            h ^= static_cast<unsigned char>(c);
+            h *= 1099511628211ULL;
+        }
+        return mix(h);
+    }
+
+public:
+    // An empty filter, which answers "maybe" for everything.
+    BloomFilter() = default;
+
+    BloomFilter(size_t values, double falsePositiveRate) {
+        double n = static_cast<double>(values > 0 ? values : 1);
+        double ln2 = log(2.0);
+        double bits = ceil(-n * log(falsePositiveRate) / (ln2 * ln2));
+        size_t wordCount = static_cast<size_t>(ceil(bits / 64));
+        if (wordCount == 0) wordCount = 1;
+        for (size_t i = 0; i < wordCount; ++i) {
+            words.append(0);
+        }
+        double k = round(static_cast<double>(wordCount * 64) / n * ln2);
+        hashes = k < 1 ? 1 : (k > 16 ? 16 : static_cast<size_t>(k));
+    }
+
+    void add(string_view value) {
+        if (hashes == 0) return;
+        uint64_t h1 = hash(value);
+        uint64_t h2 = (h1 >> 32 | h1 << 32) | 1;
+        size_t bits = words.getSize() * 64;
+        for (size_t i = 0; i < hashes; ++i) {
+            size_t bit = (h1 + i * h2) % bits;
+            words.at(bit / 64) |= uint64_t(1) << (bit % 64);
+        }
+    }
+
+    bool mayContain(string_view value) const {
+        if (hashes == 0) return true;
+        uint64_t h1 = hash(value);
+        uint64_t h2 = (h1 >> 32 | h1 << 32) | 1;
+        size_t bits = words.getSize() * 64;
+        for (size_t i = 0; i < hashes; ++i) {
+            size_t bit = (h1 + i * h2) % bits;
+            if (!((words.at(bit / 64) >> (bit % 64)) & 1)) return false;
+        }
+        return true;
+    }
+
+    // The probe count, then the words, all as little-endian 64-bit values.
+    string serialize() const {
+        string out;
+        for (size_t i = 0; i <= words.getSize(); ++i) {
+            uint64_t word = i == 0 ? hashes : words.at(i - 1);
+            for (int b = 0; b < 8; ++b) {
+                out += static_cast<char>((word >> (8 * b)) & 0xFF);
+            }
+        }
+        return out;
+    }
+
+    // Anything that is not a serialized filter gives the empty one.
+    static BloomFilter deserialize(const string& data) {
+        BloomFilter filter;
+        if (data.size() < 16 || data.size() % 8 != 0) return filter;
+        for (size_t i = 0; i < data.size(); i += 8) {
+            uint64_t word = 0;
+            for (int b = 0; b < 8; ++b) {
+                word |= static_cast<uint64_t>(static_cast<unsigned char>(data[i + b])) << (8 * b);
+            }
+            if (i == 0) {
+                filter.hashes = word;
+            } else {
+                filter.words.append(word);
+            }
+        }
+        return filter;
+    }
+};
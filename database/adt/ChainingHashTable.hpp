@@ -213,6 +213,15 @@ public:
         return numElements == 0;
     }
     
+    template <typename F>
+    void forEach(F&& visit) const {
+        for (size_t i = 0; i < capacity; ++i) {
+            for (Node* current = buckets.at(i); current != nullptr; current = current->next) {
+                visit(current->key, current->value);
+            }
+        }
+    }
+
     Array<K> getAllKeys() const {
         Array<K> keys;
         for (size_t i = 0; i < capacity; ++i) {
@@ -0,0 +1,75 @@
+// adt/Queue.hpp
+#pragma once
+
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+
+// FIFO queue on a growable ring buffer.
+template<typename T>
+class Queue {
+private:
+    T* data = nullptr;
+    size_t head = 0;
+    size_t size = 0;
+    size_t capacity = 0;
+
+    void resize() {
+        size_t newCap = (capacity == 0) ? 4 : capacity * 2;
+        T* newData = new T[newCap];
+
+        for (size_t i = 0; i < size; ++i) {
+            newData[i] = std::move(data[(head + i) % capacity]);
+        }
+
+        delete[] data;
+        data = newData;
+        head = 0;
+        capacity = newCap;
+    }
+
+public:
+    Queue() = default;
+
+    ~Queue() {
+        delete[] data;
+    }
+
+    Queue(const Queue&) = delete;
+    Queue& operator=(const Queue&) = delete;
+
+    void push(const T& value) {
+        if (size >= capacity) resize();
+        data[(head + size) % capacity] = value;
+        size++;
+    }
+
+    void push(T&& value) {
+        if (size >= capacity) resize();
+        data[(head + size) % capacity] = std::move(value);
+        size++;
+    }
+
+    T& front() {
+        if (size == 0) throw std::out_of_range("front: queue is empty");
+        return data[head];
+    }
+
+    T pop() {
+        if (size == 0) throw std::out_of_range("pop: queue is empty");
+        T value = std::move(data[head]);
+        data[head] = T();
+        head = (head + 1) % capacity;
+        size--;
+        return value;
+    }
+
+    size_t getSize() const {
+        return size;
+    }
+
+    bool empty() const {
+        return size == 0;
+    }
+};
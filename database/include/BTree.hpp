@@ -0,0 +1,109 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include "../adt/Array.hpp"
+#include "../adt/ChainingHashTable.hpp"
+
+using namespace std;
+
+// Disk-resident B+tree from byte-string keys, ordered by memcmp, to small
+// payloads. The file is an array of PAGE_SIZE pages:
+//
+//   page 0     header: "DBBTREE1", u8 clean, u64 tag, u32 root, u32 pages
+//   node page  u8 leaf, u16 count, u16 heap start, u16 garbage, u32 link,
+//              then count 16-byte slots, then the key and payload bytes
+//              growing down from the end of the page
+//
+// A slot holds the first 8 key bytes big-endian, so a binary search mostly
+// compares integers from four slots per cache line and only reads the key
+// bytes to break ties. Leaves are linked left to right through link; in an
+// inner node link is the leftmost child and each payload a u32 child page
+// holding the keys at or above its key. Pages are read through a cache of
+// at most cachePages pages and written back when evicted or saved.
+//
+// The tree carries no log. The header is marked unclean before the first
+// change after a save and clean again by the next save, with the caller's
+// tag; a file that is not clean or has another tag is started over empty.
+// Pages never merge: deletes only remove slots.
+class BTree {
+public:
+    static constexpr size_t PAGE_SIZE = 4096;
+    // Larger keys and payloads are rejected.
+    static constexpr size_t MAX_ENTRY_BYTES = PAGE_SIZE / 8;
+
+    BTree(const filesystem::path& file, size_t cachePages = 256);
+    ~BTree();
+
+    BTree(const BTree&) = delete;
+    BTree& operator=(const BTree&) = delete;
+
+    // True when the file was saved with tag; otherwise it is emptied and
+    // the caller refills it.
+    bool open(uint64_t tag);
+    // Removes every entry.
+    void clear();
+    void insert(string_view key, string_view payload);
+    // Removes key; false when it is not in the tree.
+    bool remove(string_view key);
+    // Calls visit with the key and payload of every entry with
+    // from <= key < to, in key order, until it returns false. A null bound
+    // is open.
+    void scan(const string* from, const string* to, const function<bool(string_view, string_view)>& visit);
+    // Writes every changed page and marks the file clean with tag.
+    void save(uint64_t tag);
+
+private:
+    struct Frame {
+        size_t page = 0;
+        bool dirty = false;
+        bool referenced = false;
+        size_t pins = 0;
+        unique_ptr<char[]> data;
+    };
+
+    // Keeps a page in the cache while it is in use.
+    class Pin {
+    public:
+        Pin(BTree& tree, size_t page);
+        ~Pin();
+        Pin(const Pin&) = delete;
+        Pin& operator=(const Pin&) = delete;
+        char* data() const { return frame->data.get(); }
+        void markDirty();
+
+    private:
+        Frame* frame;
+    };
+
+    struct Split {
+        bool happened = false;
+        string separator;
+        size_t page = 0;
+    };
+
+    Frame& fetch(size_t page);
+    size_t allocatePage(bool leaf);
+    void writeFrame(Frame& frame);
+    void writeHeader(bool clean, uint64_t tag);
+    void beginChange();
+    void reset();
+    Split insertInto(size_t page, string_view key, string_view payload);
+    Split place(Pin& pin, string_view key, string_view payload);
+    size_t findLeaf(string_view key);
+
+    filesystem::path file;
+    int fd = -1;
+    size_t cachePages;
+    Array<Frame> frames;
+    ChainingHashTable<size_t, size_t> frameOfPage;
+    size_t clockHand = 0;
+    size_t root = 1;
+    size_t pageCount = 0;
+    bool cleanOnDisk = false;
+    mutex access;
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include "Database.hpp"
+
+using namespace std;
+
+struct CompactorConfig {
+    // Seconds between passes over all tables; 0 turns compaction off.
+    size_t intervalSeconds = 30;
+    // Write budget of the compaction copy.
+    size_t bytesPerSecond = 8 * 1024 * 1024;
+};
+
+// Background thread that periodically compacts every table of the database
+// and logs what each pass merged.
+class Compactor {
+public:
+    Compactor(Database& db, const CompactorConfig& config);
+    ~Compactor();
+
+    Compactor(const Compactor&) = delete;
+    Compactor& operator=(const Compactor&) = delete;
+
+private:
+    void run();
+
+    Database& db;
+    CompactorConfig config;
+    mutex mtx;
+    condition_variable wake;
+    bool stopping = false;
+    thread worker;
+};
@@ -0,0 +1,53 @@
+// include/Csv.hpp
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "../adt/Array.hpp"
+
+using namespace std;
+
+// RFC 4180 CSV as stored in segment files: fields separated by ',', records
+// by '\n' (a preceding '\r' is dropped). A field starting with '"' runs to
+// the matching unescaped '"', may contain ',' and '\n', and writes '"' as "".
+
+// Bit i is set when p[i] is ',', '"' or '\n', for the first min(length, 64)
+// bytes. Uses AVX2 or SSE2 compares, whichever the CPU has, and a bytewise
+// loop elsewhere.
+uint64_t findCsvSpecials(const char* p, size_t length);
+
+// Walks the records of a buffer in place. Structural characters are found
+// 64 bytes at a time and consumed from a bitmask, so short fields cost a
+// bit scan rather than a search each. Empty lines between records are
+// skipped.
+class CsvCursor {
+public:
+    explicit CsvCursor(string_view text);
+
+    // Fills row[offset, offset + width) with the next record, assigning into
+    // the existing cells. Missing fields become empty, extra ones are dropped.
+    bool next(Array<string>& row, size_t offset, size_t width);
+    // Steps over the next record without storing it.
+    bool skip();
+    // Where the next record (or the blank lines before it) starts.
+    const char* position() const;
+
+private:
+    bool parseRecord(Array<string>* row, size_t offset, size_t width);
+    void parseField(string* cell, bool& recordEnd);
+    const char* nextSpecial();
+
+    const char* p;
+    const char* end;
+    const char* block = nullptr;
+    uint64_t mask = 0;
+};
+
+// Splits a single record, assigning into the existing cells so that
+// warmed-up rows are refilled without allocating.
+void splitCsvLine(string_view line, Array<string>& row, size_t offset, size_t width);
+
+// Appends value as one field, quoted only when it contains ',', '"', '\r'
+// or '\n'.
+void appendCsvField(string& out, string_view value);
@@ -3,6 +3,10 @@
 
 #include "Table.hpp"
 #include "Schema.hpp"
+#include "FileLock.hpp"
+#include "WriteAheadLog.hpp"
+#include <memory>
+#include <mutex>
 #include "../adt/ChainingHashTable.hpp"
 
 using namespace std;
@@ -11,17 +15,43 @@ class Database {
 public:
     explicit Database(const Schema& schema);
     ~Database();
+
+    Database(const Database&) = delete;
+    Database& operator=(const Database&) = delete;
+
     Table& getTable(const string& name);
     bool hasTable(const string& name) const;
     Array<string> getTableNames() const;
     string getSchemaName() const;
 
+    // Makes every table durable and empties the WAL. Runs after recovery,
+    // on shutdown, and from checkpointIfNeeded once the log has grown past
+    // WAL_CHECKPOINT_BYTES.
+    void checkpoint();
+    void checkpointIfNeeded();
+
+    // CREATE INDEX / DROP INDEX. The index catalog records which columns
+    // are indexed so the indexes are loaded again on the next start.
+    void createIndex(const string& table, const IndexDefinition& definition);
+    void dropIndex(const string& table, const string& column);
 
 private:
     void initializeStorage();
     void lock();
     void unlock();
+    void recover();
+    void loadIndexCatalog();
+    void saveIndexCatalog();
+
+    static constexpr size_t WAL_CHECKPOINT_BYTES = 64 * 1024 * 1024;
+
     Schema schema;
     ChainingHashTable<string, Table> tables;
     filesystem::path lockFile;
+    unique_ptr<FileLock> fileLock;
+    shared_ptr<WriteAheadLog> wal;
+    // Indexes by table, kept in <schema>/indexes.json.
+    ChainingHashTable<string, Array<IndexDefinition>> indexCatalog;
+    filesystem::path indexCatalogFile;
+    mutex catalogLock;
 }; 
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <ostream>
+#include "Database.hpp"
+#include "../adt/Array.hpp"
+
+using namespace std;
+
+// Outcome of a statement: rows returned (SELECT) or affected, and the number
+// of projected columns.
+struct QueryStatus {
+    bool ok = true;
+    size_t rows = 0;
+    size_t columns = 0;
+    // Sealed segments scans passed over, by zone map and by Bloom filter.
+    size_t zoneSkipped = 0;
+    size_t bloomSkipped = 0;
+};
+
+QueryStatus executeSelect(const Array<string>& tokens, Database& db, ostream& out);
+QueryStatus executeInsert(const Array<string>& tokens, Database& db, ostream& out);
+QueryStatus executeDelete(const Array<string>& tokens, Database& db, ostream& out);
+// CREATE INDEX ON table ( column ) [USING HASH | BTREE] and
+// DROP INDEX ON table ( column ).
+QueryStatus executeCreateIndex(const Array<string>& tokens, Database& db, ostream& out);
+QueryStatus executeDropIndex(const Array<string>& tokens, Database& db, ostream& out);
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include <filesystem>
+
+using namespace std;
+
+// Advisory flock(2) lock on a file that stays open for the lifetime of the
+// object. The kernel drops the lock when the descriptor is closed, including
+// when the process dies, so a crash never leaves a stale lock behind.
+// flock only excludes other open descriptions of the file; threads sharing
+// one FileLock have to be serialized by the caller.
+class FileLock {
+public:
+    explicit FileLock(const filesystem::path& path);
+    ~FileLock();
+
+    FileLock(const FileLock&) = delete;
+    FileLock& operator=(const FileLock&) = delete;
+
+    void lock();
+    bool tryLock();
+    void unlock();
+
+private:
+    string path;
+    int fd = -1;
+};
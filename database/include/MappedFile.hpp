@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <filesystem>
+
+using namespace std;
+
+// Read-only mmap(2) of a whole file. The mapping stays valid after the file
+// is renamed over or unlinked, so a reader keeps a consistent view of a
+// segment that compaction replaces under it.
+class MappedFile {
+public:
+    // How the mapping will be read, passed on to madvise: scans read ahead,
+    // lookups of scattered rows do not.
+    enum class Access { Sequential, Random };
+
+    explicit MappedFile(const filesystem::path& path, Access access = Access::Sequential);
+    // Maps a descriptor the caller keeps open; path is only for errors.
+    MappedFile(int fd, const filesystem::path& path, Access access = Access::Sequential);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const;
+    size_t size() const;
+    string_view view() const;
+
+private:
+    const char* mapping = nullptr;
+    size_t length = 0;
+
+    void map(int fd, const filesystem::path& path, Access access);
+};
+
+// Asks the kernel to start reading a file into the page cache, so the next
+// segment of a scan is loading while the current one is parsed.
+void prefetchFile(const filesystem::path& path);
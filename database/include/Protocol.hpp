@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+using namespace std;
+
+// Framed wire protocol between database-server and database-client.
+//
+// A client opts in by sending FRAME_HANDSHAKE as the first bytes of the
+// connection; the server echoes it back. Connections that start with anything
+// else stay in the legacy text mode, where every recv() is one query.
+//
+// Every frame is a 5-byte header (payload length as big-endian uint32, then
+// the frame type) followed by the payload. The client sends one QUERY frame
+// per statement; the server answers with any number of DATA frames carrying
+// result text and one COMPLETE frame:
+//   uint8 status | uint64 row count | uint32 column count   (big-endian)
+constexpr char FRAME_HANDSHAKE[] = "DBFRAME1";
+constexpr size_t FRAME_HANDSHAKE_SIZE = sizeof(FRAME_HANDSHAKE) - 1;
+constexpr size_t FRAME_HEADER_SIZE = 5;
+constexpr size_t FRAME_MAX_PAYLOAD = 64 * 1024 * 1024;
+
+enum class FrameType : uint8_t {
+    Query = 'Q',
+    Data = 'D',
+    Complete = 'C',
+};
+
+enum class FrameStatus : uint8_t {
+    Ok = 0,
+    Error = 1,
+};
+
+struct Frame {
+    FrameType type = FrameType::Data;
+    string payload;
+};
+
+struct FrameCompletion {
+    FrameStatus status = FrameStatus::Ok;
+    uint64_t rows = 0;
+    uint32_t columns = 0;
+};
+
+bool sendAll(int socket, const char* data, size_t length);
+void writeHeader(char* header, FrameType type, size_t payloadSize);
+string encodeFrame(FrameType type, const string& payload);
+string encodeCompletion(const FrameCompletion& completion);
+bool sendFrame(int socket, FrameType type, const string& payload);
+FrameCompletion parseCompletion(const string& payload);
+// Removes the first complete frame from buffer, if it holds one.
+bool takeFrame(string& buffer, Frame& frame);
+
+// Reads frames from a socket. Bytes already received before the reader was
+// created (e.g. those that followed the handshake) are passed in as pending.
+class FrameReader {
+public:
+    explicit FrameReader(int socket, string pending = "");
+    bool next(Frame& frame);
+
+private:
+
+    int socket;
+    string buffer;
+};
+
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <string>
+#include "../adt/Array.hpp"
+#include "../adt/ChainingHashTable.hpp"
+#include "Value.hpp"
+
+using namespace std;
+
+Array<string> tokenize(const string& query);
+string stripQuotes(const string& s);
+
+// Column reference resolved to a row slot, or a constant taken from the query.
+struct Operand {
+    bool isColumn = false;
+    size_t slot = 0;
+    string literal;
+};
+
+struct PredicateNode {
+    enum class Kind { And, Or, Equals, Less, LessEqual, Greater, GreaterEqual };
+
+    Kind kind = Kind::Equals;
+    size_t left = 0;
+    size_t right = 0;
+    Operand lhs;
+    Operand rhs;
+    // What a comparison orders its operands as.
+    ColumnType type = ColumnType::Untyped;
+};
+
+// Comparisons are leaves; And and Or have children. Values compare with
+// compareCells except for `=`, which is exact on canonical cells. An empty
+// cell is null: `=` matches it only to '', the other operators never.
+bool isComparison(PredicateNode::Kind kind);
+
+// WHERE clause compiled once per query. Nodes live in a flat array and refer
+// to their children by index; evaluation reads row cells by slot and does not
+// allocate.
+class Predicate {
+public:
+    // types gives the ColumnType of each slot; slots past its end are untyped.
+    static Predicate compile(const Array<string>& tokens, const ChainingHashTable<string, size_t>& columns,
+                             const Array<ColumnType>& types = Array<ColumnType>());
+
+    bool empty() const;
+    bool evaluate(const Array<string>& row) const;
+
+    // Top-level AND operands as standalone predicates.
+    Array<Predicate> splitConjuncts() const;
+    // True when the predicate is a single `column = column` comparison.
+    bool getColumnEquality(size_t& lhsSlot, size_t& rhsSlot) const;
+    // True when the predicate is a single `column = 'constant'` comparison,
+    // in either order.
+    bool getConstantEquality(size_t& slot, string& value) const;
+    // True when the predicate compares a column with a constant, in either
+    // order; kind is stated with the column on the left.
+    bool getConstantComparison(size_t& slot, PredicateNode::Kind& kind, string& value) const;
+    // Appends the slot of every column the predicate reads.
+    void collectSlots(Array<size_t>& slots) const;
+
+private:
+    size_t parseExpression(const Array<string>& tokens, size_t& pos, const ChainingHashTable<string, size_t>& columns,
+                           const Array<ColumnType>& types);
+    size_t parseTerm(const Array<string>& tokens, size_t& pos, const ChainingHashTable<string, size_t>& columns,
+                     const Array<ColumnType>& types);
+    size_t parseFactor(const Array<string>& tokens, size_t& pos, const ChainingHashTable<string, size_t>& columns,
+                       const Array<ColumnType>& types);
+    size_t parseCondition(const Array<string>& tokens, size_t& pos, const ChainingHashTable<string, size_t>& columns,
+                          const Array<ColumnType>& types);
+    size_t addComparison(PredicateNode::Kind kind, const string& lhs, const string& rhs,
+                         const ChainingHashTable<string, size_t>& columns, const Array<ColumnType>& types);
+    size_t addNode(PredicateNode node);
+    size_t copySubtree(const Predicate& from, size_t index);
+    void collectConjuncts(size_t index, Array<Predicate>& out) const;
+
+    bool evaluateNode(size_t index, const Array<string>& row) const;
+    static const string& operandValue(const Operand& operand, const Array<string>& row);
+    static Operand resolveOperand(const string& token, const ChainingHashTable<string, size_t>& columns);
+
+    Array<PredicateNode> nodes;
+    size_t root = 0;
+};
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include "WorkerPool.hpp"
+#include "../adt/Array.hpp"
+#include "../adt/Queue.hpp"
+#include "../adt/ChainingHashTable.hpp"
+
+using namespace std;
+
+struct ReactorConfig {
+    int port = 7432;
+    int backlog = 128;
+    size_t maxConnections = 1024;
+    size_t workers = 4;
+    size_t queueDepth = 256;
+    // Requests a single connection may have parsed but not yet executed
+    // before the reactor stops reading from it.
+    size_t maxPendingRequests = 16;
+    // Queued output above which a worker producing a result has to wait
+    // for the reactor to drain the socket.
+    size_t outputHighWater = 1024 * 1024;
+    // Seconds a worker waits for that output to drain before it gives up
+    // the query and the connection is closed, so clients that stop reading
+    // cannot hold every worker.
+    size_t writeTimeoutSeconds = 30;
+};
+
+// One client socket. Input parsing, request queueing and all socket I/O
+// happen on the reactor thread; workers only append output through write().
+class Connection {
+public:
+    Connection(int fd, size_t outputHighWater, chrono::seconds writeTimeout);
+
+    int getFd() const;
+    bool isFramed() const;
+
+    // Queues output for the reactor to send. Blocks while more than the
+    // high-water mark is already queued; returns false once the connection
+    // is gone, or when nothing drained within the write timeout, after
+    // which the reactor closes it.
+    bool write(string chunk);
+    // Closes the connection after the output queued so far has been sent.
+    void requestClose();
+
+private:
+    friend class Reactor;
+
+    int fd;
+    size_t outputHighWater;
+    chrono::seconds writeTimeout;
+    function<void()> onOutput;
+
+    // Reactor thread only.
+    string input;
+    bool handshakeChecked = false;
+    bool framed = false;
+    Queue<string> requests;
+    bool waitingForWorker = false;
+    bool readPaused = false;
+    bool writeArmed = false;
+
+    // Shared with the worker running this connection's request.
+    mutex mtx;
+    condition_variable drained;
+    Queue<string> output;
+    size_t outputOffset = 0;
+    size_t outputBytes = 0;
+    bool busy = false;
+    bool closing = false;
+    bool stalled = false;
+    bool closed = false;
+};
+
+using RequestHandler = function<void(Connection& connection, const string& query)>;
+
+// Single-threaded epoll loop that accepts clients, reads and frames their
+// requests and writes their output with non-blocking sockets. Queries run on
+// a fixed worker pool, one at a time per connection and in arrival order.
+class Reactor {
+public:
+    Reactor(const ReactorConfig& config, RequestHandler handler);
+    ~Reactor();
+
+    Reactor(const Reactor&) = delete;
+    Reactor& operator=(const Reactor&) = delete;
+
+    void run();
+
+private:
+    void acceptConnections();
+    void readFrom(const shared_ptr<Connection>& connection);
+    void parseRequests(Connection& connection);
+    void flushOutput(const shared_ptr<Connection>& connection);
+    void dispatch(const shared_ptr<Connection>& connection);
+    void retryWaiting();
+    void processWakeups();
+    void updateInterest(Connection& connection);
+    void closeConnection(const shared_ptr<Connection>& connection);
+    void wake(const shared_ptr<Connection>& connection);
+
+    ReactorConfig config;
+    RequestHandler handler;
+    WorkerPool pool;
+    int listenFd = -1;
+    int epollFd = -1;
+    int wakeFd = -1;
+    ChainingHashTable<int, shared_ptr<Connection>> connections;
+    Queue<shared_ptr<Connection>> waiting;
+
+    mutex wakeMutex;
+    Queue<shared_ptr<Connection>> wakeups;
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include "../adt/Array.hpp"
+#include "../adt/ChainingHashTable.hpp"
+#include "Value.hpp"
+
+using namespace std;
+
+// Fixed column layout of an execution row. Every table of a query owns a
+// contiguous range of slots: its pk first, then its columns in schema order.
+// Names are resolved to slots once per query; rows are plain cell arrays.
+class RowLayout {
+public:
+    // types holds the type of the pk and of each column, or nothing when
+    // the table is untyped.
+    size_t addTable(const string& name, const string& pkName, const Array<string>& columns,
+                    const Array<ColumnType>& types = Array<ColumnType>());
+
+    bool resolve(const string& name, size_t& slot) const;
+    const ChainingHashTable<string, size_t>& getSlots() const;
+    const Array<ColumnType>& getSlotTypes() const;
+
+    size_t getWidth() const;
+    size_t getTableCount() const;
+    size_t getTableOffset(size_t table) const;
+    size_t getTableWidth(size_t table) const;
+    size_t getTableOfSlot(size_t slot) const;
+
+    Array<string> makeRow() const;
+
+private:
+    ChainingHashTable<string, size_t> slots;
+    Array<ColumnType> slotTypes;
+    Array<size_t> offsets;
+    Array<size_t> widths;
+    size_t width = 0;
+};
@@ -6,6 +6,7 @@
 #include <filesystem>
 #include "../adt/ChainingHashTable.hpp"
 #include "../adt/Array.hpp"
+#include "Value.hpp"
 
 using namespace std;
 using json = nlohmann::json;
@@ -14,6 +15,19 @@ struct Schema {
     string name;
     size_t tuplesLimit;
     ChainingHashTable<string, Array<string>> structure;
+    // A column is a name or {"name": ..., "type": "int64" | "double" | "bool"
+    // | "text" | "timestamp"}; parallel to structure, Untyped for bare names.
+    ChainingHashTable<string, Array<ColumnType>> columnTypes;
+    // Optional "wal_sync": "always" | "interval" | "os", with
+    // "wal_sync_interval_ms" for the interval mode.
+    string walSync = "always";
+    size_t walSyncIntervalMs = 10;
+    // Optional "storage": "csv" | "columnar", how sealed segments are kept.
+    string storage = "csv";
+    // Optional "bloom_filters": {"table": ["column", ...]}, columns whose
+    // sealed segments get a Bloom filter, with "bloom_false_positive_rate".
+    ChainingHashTable<string, Array<string>> bloomFilters;
+    double bloomFalsePositiveRate = 0.01;
 
     static Schema loadFromFile(const filesystem::path& path);
     Array<string> getTableNames() const;
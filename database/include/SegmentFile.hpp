@@ -0,0 +1,163 @@
+// include/SegmentFile.hpp
+#pragma once
+
+#include <string>
+#include <filesystem>
+#include <string_view>
+#include <memory>
+#include <mutex>
+#include "MappedFile.hpp"
+#include "Csv.hpp"
+#include "Value.hpp"
+#include "../adt/Array.hpp"
+#include "../adt/Bitmap.hpp"
+#include "../adt/BloomFilter.hpp"
+
+using namespace std;
+
+// The active segment of a table is always a CSV file so rows can be appended.
+// Tables stored as columnar convert each segment to N.col once it is sealed:
+//
+//   column block * columns   u32 offsets[rows + 1], then the cell bytes
+//   directory                u64 block offset, u64 block length and u64
+//                            encoding per column
+//   footer                   u64 rows, u32 columns, "DBCOLEN2"
+//
+// Integers are little-endian; offsets are relative to the end of the block's
+// offset array. A column whose encoding is a ColumnType with a binaryWidth
+// has no offsets; its block is the encodeBinary form of each cell instead.
+// Files ending in "DBCOLEND" have 16-byte directory entries and text blocks
+// only.
+const char* const CSV_EXTENSION = ".csv";
+const char* const COLUMNAR_EXTENSION = ".col";
+
+// Bounds of the cells of a sealed segment, kept next to it as N.zone so
+// scans can pass over segments that cannot hold a match. min and max are
+// in compareCells order of the column's type over its non-empty cells,
+// which are counted in nulls instead. Deleted rows are included.
+struct ZoneMap {
+    size_t rows = 0;
+    // One per column; set before the first row is added.
+    Array<ColumnType> types;
+    Array<string> min;
+    Array<string> max;
+    Array<size_t> nulls;
+
+    // Widens the map by the row in cells[offset, offset + types.getSize()).
+    void addRow(const Array<string>& cells, size_t offset);
+};
+
+// Bloom filters over the cells of some columns of a sealed segment, deleted
+// rows included, kept next to it as N.bloom. They rule out equalities on
+// columns whose values are spread too evenly for the zone map to.
+struct SegmentBlooms {
+    size_t rows = 0;
+    Array<size_t> columns;
+    Array<BloomFilter> filters;
+};
+
+// The file behind a segment, shared by every copy of its Segment. Cursors
+// map a segment only once they reach it, without the table lock, so the
+// table pins the handle before it renames over or removes the file: the
+// descriptor it opens stays open while any copy lives, and map reads it
+// instead of whatever the path names by then.
+class SegmentHandle {
+public:
+    explicit SegmentHandle(filesystem::path path);
+    ~SegmentHandle();
+
+    SegmentHandle(const SegmentHandle&) = delete;
+    SegmentHandle& operator=(const SegmentHandle&) = delete;
+
+    void pin();
+    shared_ptr<const MappedFile> map(MappedFile::Access access) const;
+
+private:
+    filesystem::path path;
+    mutable mutex lock;
+    int fd = -1;
+};
+
+// A data file and the rows deleted from it that are still physically
+// present, by ordinal of the row within the file. The bitmap is kept next
+// to the file as N.del.
+struct Segment {
+    filesystem::path file;
+    // Set for the segments in a table's list.
+    shared_ptr<SegmentHandle> handle;
+    size_t rows = 0;
+    Bitmap deleted;
+    // Set once the segment is sealed; the active segment has neither.
+    shared_ptr<const ZoneMap> zone;
+    shared_ptr<const SegmentBlooms> blooms;
+};
+
+// Where a row is stored: which segment, its ordinal within the file, and
+// for CSV files the byte offset of its record. What segment refers to is up
+// to the holder.
+struct RowLocation {
+    size_t segment = 0;
+    size_t ordinal = 0;
+    size_t offset = 0;
+};
+
+bool isColumnar(const filesystem::path& file);
+// Data rows stored in a segment file of either format.
+size_t countRows(const filesystem::path& file);
+
+// Writes the data rows of a CSV segment to target in the columnar format
+// and syncs it, one column per type. A typed column is stored in binary
+// when all its cells are canonical and non-empty. Returns the number of
+// rows written.
+size_t writeColumnar(const filesystem::path& csvFile, const filesystem::path& target,
+                     const Array<ColumnType>& types);
+
+// Reads the live rows of a segment in file order, whatever its format. The
+// file is mapped and walked in place; cells are copied straight from the
+// mapping into the caller's row. With a column mask only the marked columns
+// are filled in, and a columnar segment never touches the pages of the rest.
+class SegmentReader {
+public:
+    // mapped, when given, is the segment's file mapped earlier; the reader
+    // then sees the file as it was at that point.
+    SegmentReader(const Segment& segment, size_t width, const Array<bool>* columns = nullptr,
+                  shared_ptr<const MappedFile> mapped = nullptr);
+
+    SegmentReader(const SegmentReader&) = delete;
+    SegmentReader& operator=(const SegmentReader&) = delete;
+
+    // Fills row[offset, offset + width) with the next row not marked
+    // deleted; false once the segment is exhausted.
+    bool next(Array<string>& row, size_t offset);
+    // Ordinal within the file of the row last returned by next.
+    size_t getOrdinal() const;
+    // Byte offset of that row's record in a CSV file; 0 for columnar files.
+    size_t getOffset() const;
+
+    // Reads a single row by its location, without touching the rest of the
+    // file; false when the row is deleted or out of range.
+    bool readAt(const RowLocation& location, Array<string>& row, size_t offset);
+
+private:
+    const Segment& segment;
+    size_t width;
+    bool columnar;
+    shared_ptr<const MappedFile> file;
+    size_t ordinal = 0;
+    size_t rowOffset = 0;
+    size_t position = 0;
+
+    // CSV: the records after the header.
+    CsvCursor csv{string_view()};
+
+    // Columnar: the offsets and cell bytes of each loaded column, and how
+    // its cells are encoded; binary columns have no offsets.
+    size_t rowCount = 0;
+    Array<const char*> offsets;
+    Array<const char*> cells;
+    // Bytes of cells behind each text column's offsets.
+    Array<size_t> cellBytes;
+    Array<ColumnType> encodings;
+
+    void readCell(size_t column, size_t row, string& out) const;
+};
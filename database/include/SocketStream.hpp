@@ -0,0 +1,37 @@
+#pragma once
+
+#include <streambuf>
+#include "Reactor.hpp"
+
+using namespace std;
+
+// Output buffer over a client connection. Data is handed to the connection
+// whenever the fixed-size buffer fills up or the stream is flushed, so a
+// result reaches the client in bounded chunks while it is being produced.
+// Connection::write blocks while the client is not draining its output,
+// which throttles the producing query. On framed connections every chunk
+// goes out as one DATA frame.
+class SocketStreamBuf : public streambuf {
+public:
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+
+    explicit SocketStreamBuf(Connection& connection, size_t chunkSize = DEFAULT_CHUNK_SIZE);
+    ~SocketStreamBuf() override;
+
+    SocketStreamBuf(const SocketStreamBuf&) = delete;
+    SocketStreamBuf& operator=(const SocketStreamBuf&) = delete;
+
+protected:
+    int overflow(int c) override;
+    streamsize xsputn(const char* s, streamsize n) override;
+    int sync() override;
+
+private:
+    bool flushBuffer();
+    bool sendChunk(const char* data, size_t length);
+
+    Connection& connection;
+    char* buffer;
+    size_t chunkSize;
+    bool failed = false;
+};
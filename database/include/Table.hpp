@@ -3,41 +3,316 @@
 #include <string>
 #include <filesystem>
 #include <functional>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+#include <shared_mutex>
+#include "FileLock.hpp"
+#include "WriteAheadLog.hpp"
+#include "SegmentFile.hpp"
+#include "BTree.hpp"
 #include "../adt/Array.hpp"
+#include "../adt/ChainingHashTable.hpp"
 
 using namespace std;
 
+// A secondary index: a hash index serves equality, an ordered (B+tree)
+// index also serves ranges and yields rows in value order.
+struct IndexDefinition {
+    string column;
+    bool ordered = false;
+};
+
+// Values of one column (0 is the pk) a statement is limited to. An
+// equality holds the value in low; otherwise each set bound is inclusive
+// and the range holds no empty cells.
+struct ColumnRange {
+    size_t column = 0;
+    bool equality = false;
+    bool hasLow = false;
+    bool hasHigh = false;
+    string low;
+    string high;
+};
+
 struct TableConfig {
     string name;
     size_t tuplesLimit;
     filesystem::path basePath;
     Array<string> columns;
+    // Declared type of each column, in the same order; empty when untyped.
+    Array<ColumnType> types;
+    // Inserts and deletes are logged here before touching the data files.
+    shared_ptr<WriteAheadLog> wal;
+    // Convert segments to the columnar format once they are sealed.
+    bool columnar = false;
+    // Secondary indexes, as recorded in the index catalog.
+    Array<IndexDefinition> indexes;
+    // Columns whose sealed segments carry a Bloom filter, and the rate of
+    // false positives the filters are sized for.
+    Array<string> bloomColumns;
+    double bloomFalsePositiveRate = 0.01;
+};
+
+struct CompactionStats {
+    size_t segmentsMerged = 0;
+    size_t segmentsWritten = 0;
+    size_t rowsDropped = 0;
+    size_t bytesWritten = 0;
+};
+
+// Up to TableCursor::BATCH_ROWS rows of one table, cells stored row-major.
+// The cell strings are refilled in place from batch to batch, so a caller
+// may swap cells out and leave the emptied strings behind.
+struct RowBatch {
+    size_t width = 0;
+    size_t rows = 0;
+    Array<string> cells;
+    // Where each row lives; segment is an index into the scanned list.
+    Array<RowLocation> locations;
+
+    string& cell(size_t row, size_t column) { return cells.at(row * width + column); }
+    const string& cell(size_t row, size_t column) const { return cells.at(row * width + column); }
+};
+
+// Pull-based scan over a fixed list of segments, the ones current when the
+// cursor was opened. Opening it needs the table's lockForRead (or
+// lockForWrite); reading it does not, so the lock may be released right
+// after. Memory is bounded by one batch, the mapping of the segment being
+// read and that of the last segment.
+class TableCursor {
+public:
+    static constexpr size_t BATCH_ROWS = 1024;
+
+    // The last segment, which may be the active one, is mapped when the
+    // cursor is opened, so rows appended to it later lie past the mapped
+    // length. The others are sealed and mapped one at a time as the cursor
+    // reaches them, through their SegmentHandle, which keeps a file that
+    // compaction or sealing replaces readable until the cursor is closed.
+    //
+    // columns, when not empty, marks the cells the caller needs; the others
+    // may be left empty. Segments whose zone map or Bloom filters show no
+    // cell in one of ranges are passed over.
+    TableCursor(Array<Segment> segments, size_t width, Array<bool> columns = Array<bool>(),
+                const Array<ColumnRange>& ranges = Array<ColumnRange>());
+    // Reads only the given rows, in order, instead of every segment.
+    TableCursor(Array<Segment> segments, size_t width, Array<bool> columns, Array<RowLocation> targets);
+    ~TableCursor();
+
+    TableCursor(const TableCursor&) = delete;
+    TableCursor& operator=(const TableCursor&) = delete;
+
+    // Fills batch with the next rows; false once the scan is exhausted.
+    bool nextBatch(RowBatch& batch);
+    void close();
+    // Segments passed over without being read, by zone map and by Bloom
+    // filter.
+    size_t getZoneSkipped() const;
+    size_t getBloomSkipped() const;
+
+private:
+    Array<Segment> segments;
+    size_t width;
+    Array<bool> columns;
+    // Positions in segments of the ones a scan reads.
+    Array<size_t> scanned;
+    size_t current = 0;
+    size_t zoneSkipped = 0;
+    size_t bloomSkipped = 0;
+    unique_ptr<SegmentReader> reader;
+    size_t readerSegment = 0;
+    bool lookup = false;
+    Array<RowLocation> targets;
+    // The last segment, mapped on opening when the cursor reads it.
+    shared_ptr<const MappedFile> tail;
+
+    void mapTail();
+    shared_ptr<const MappedFile> mapSegment(size_t segment) const;
 };
 
 class Table {
 public:
     explicit Table(const TableConfig & config);
     
+    // Single-row inserts arriving concurrently are group-committed: the first
+    // caller appends every row queued behind it with one write and flush.
     void insert(const Array<string>& values);
+    // Appends all rows under one lock acquisition and one flush.
+    void insertBatch(const Array<Array<string>>& rows);
     
-    void deleteRows(const function<bool(const Array<string>& row, const Array<string>& columns)>& predicate);
+    // With range set, only rows whose cell may lie in it are considered;
+    // without, segments ruled out by bounds are not read.
+    size_t deleteRows(const function<bool(const Array<string>& row, const Array<string>& columns)>& predicate,
+                      const ColumnRange* range = nullptr, const Array<ColumnRange>& bounds = Array<ColumnRange>());
+
+    // Opens a scan of the table's live rows, pk first, passing over sealed
+    // segments whose zone map or Bloom filters show no cell in one of
+    // bounds. The caller holds lockForRead while opening the cursor; it
+    // may be read after the lock is released.
+    TableCursor openScan(Array<bool> columns = Array<bool>(),
+                         const Array<ColumnRange>& bounds = Array<ColumnRange>()) const;
+    // Like openScan, but yields only rows whose cell may lie in range: the
+    // rows an index points at, or every row when no index serves the range
+    // or the index names too much of the table to beat a scan. Callers
+    // still apply their own filters.
+    TableCursor openLookup(const ColumnRange& range, Array<bool> columns = Array<bool>()) const;
+    size_t getWidth() const;
+
+    // Builds a persistent index from the values of a column to the rows
+    // holding them, or drops one. The index is kept up to date by inserts
+    // and deletes and saved at checkpoints like the pk index.
+    void createIndex(const IndexDefinition& definition);
+    void dropIndex(const string& column);
+    // True when an index serves lookups of range. The caller holds
+    // lockForRead.
+    bool hasIndex(const ColumnRange& range) const;
 
-    Array<Array<string>> scan();
-    
     const Array<string>& getColumns() const;
+    // Type of each cell of a row, the untyped pk first.
+    const Array<ColumnType>& getColumnTypes() const;
     string getPkColumnName() const;
+    // Data segments in order, for size estimates. Callers hold lockForRead
+    // while using them.
+    Array<Segment> getSegments() const;
+
+    // Shared access for readers of the data files. insert and deleteRows take
+    // the same lock exclusively, so a reader never sees a file mid-rewrite.
+    shared_lock<shared_mutex> lockForRead() const;
+    unique_lock<shared_mutex> lockForWrite();
+
+    // Redoes logged changes that may not have reached the data files.
+    // Primary keys are never reused, so rows already present are skipped
+    // and replaying a record twice is harmless.
+    void recover(const Array<const WalRecord*>& records);
+    // Forces appended and rewritten segments and the pk index to stable
+    // storage. The caller holds lockForWrite.
+    void syncToDisk();
+
+    // Rewrites sealed segments that are less than half full or at least a
+    // quarter deleted into as few full segments as possible, dropping the
+    // deleted rows. The copy runs without the table lock and writes at most
+    // bytesPerSecond; only the final swap takes it exclusively.
+    CompactionStats compact(size_t bytesPerSecond);
 
 private:
     size_t getNextId();
+    void reserveIds(size_t upTo);
     void lock();
     void unlock();
     
-    Array<filesystem::path> getDataFiles() const;
-    filesystem::path getCurrentDataFilePath() const;
-    size_t getCurrentFileRowCount() const;
+    // The values of a new row with each in its column's canonical form;
+    // throws when there are too few or too many, or one is not of its type.
+    Array<string> canonicalRow(const Array<string>& values) const;
+    void appendRows(const Array<const Array<string>*>& rows);
+    void writeRows(const Array<Array<string>>& rows);
+    size_t removeRows(const function<bool(const Array<string>&, const Array<string>&)>& predicate, bool logged,
+                      const Array<string>* keys = nullptr, const Array<ColumnRange>& bounds = Array<ColumnRange>());
+    void saveDeleted(const Segment& segment);
+    void loadSegments();
+    void trimTornRecord(Segment& segment);
+    void sealSegment(Segment& segment);
+    bool isSummarized(const Segment& segment) const;
+    void summarize(Segment& segment);
+    void loadPkIndex();
+    void rebuildPkIndex();
+    void savePkIndex();
+    string segmentFingerprint() const;
+    bool matchesFingerprint(const string& data, size_t& pos) const;
+    size_t findColumn(const string& column) const;
+    struct SecondaryIndex;
+    SecondaryIndex* findIndex(size_t column) const;
+    filesystem::path indexFile(const SecondaryIndex& index) const;
+    uint64_t indexTag(const SecondaryIndex& index) const;
+    void addToIndex(SecondaryIndex& index, const string& value, const string& key);
+    void removeFromIndex(SecondaryIndex& index, const string& value, const string& key);
+    void loadIndex(SecondaryIndex& index);
+    void rebuildIndex(SecondaryIndex& index);
+    void saveIndex(SecondaryIndex& index);
+    bool lookupKeys(const ColumnRange& range, Array<string>& keys) const;
+    Array<RowLocation> locate(const Array<string>& keys) const;
+    size_t findSegment(size_t number) const;
+    void finishCompaction();
+    ofstream& activeSegment();
 
     TableConfig config;
     string pkColumnName;
+    // config.types by position in a row.
+    Array<ColumnType> rowTypes;
+    // Positions of config.bloomColumns in a row.
+    Array<size_t> bloomColumns;
     filesystem::path pkSequenceFile;
-    filesystem::path lockFile;
+    // Shared between copies of the table: accessLock orders threads of this
+    // process, fileLock excludes other processes writing the same files.
+    shared_ptr<shared_mutex> accessLock;
+    shared_ptr<FileLock> fileLock;
+
+    // Primary keys are handed out from memory. The sequence file holds the
+    // end of the block reserved so far, written before any id in the block
+    // is used, so after a crash numbering resumes past every issued id.
+    static constexpr size_t ID_BLOCK_SIZE = 1000;
+    struct IdSequence {
+        atomic<size_t> last{0};
+        atomic<size_t> reserved{0};
+        mutex refill;
+    };
+    shared_ptr<IdSequence> idSequence;
+
+    // Segment list and the open append handle of the last segment, guarded
+    // by accessLock. Only the directory listing at startup touches the disk.
+    struct Segments {
+        Array<Segment> list;
+        ofstream appender;
+        // Size of the active segment as far as the appender has written.
+        size_t appendOffset = 0;
+        mutex compaction;
+    };
+    shared_ptr<Segments> segments;
+
+    // Primary key -> row, with RowLocation::segment holding the number in
+    // the segment's file name so it survives compaction reordering the
+    // list. Guarded by accessLock like the segment list. Saved at checkpoints
+    // to pkIndexFile together with the row and delete counts of every
+    // segment; a file that does not match the segments on disk is ignored
+    // and the index rebuilt by a scan.
+    struct PkIndex {
+        ChainingHashTable<string, RowLocation> rows;
+        // False when a segment is not named by a number; lookups then fall
+        // back to scanning.
+        bool complete = true;
+        bool dirty = false;
+    };
+    shared_ptr<PkIndex> pkIndex;
+    filesystem::path pkIndexFile;
+
+    // Secondary indexes map a column value to the primary keys of the rows
+    // holding it, and reach the rows through the pk index, so compaction
+    // moving rows leaves them untouched. A hash index lives in memory and is
+    // saved to indexFile with the same segment fingerprint as the pk index.
+    // An ordered index is a B+tree in indexFile keyed by the value's
+    // encodeOrderedKey, cut to MAX_ORDERED_VALUE_BYTES, then the pk's; the
+    // fingerprint goes into its tag.
+    static constexpr size_t MAX_ORDERED_VALUE_BYTES = 256;
+    struct SecondaryIndex {
+        size_t column = 0;
+        bool ordered = false;
+        ChainingHashTable<string, Array<string>> keys;
+        unique_ptr<BTree> tree;
+        bool dirty = false;
+    };
+    shared_ptr<Array<shared_ptr<SecondaryIndex>>> indexes;
+
+    struct PendingInsert {
+        const Array<string>* values;
+        bool done = false;
+        string error;
+    };
+    struct CommitQueue {
+        mutex mtx;
+        condition_variable committed;
+        Array<PendingInsert*> pending;
+        bool leaderActive = false;
+    };
+    shared_ptr<CommitQueue> commitQueue;
 }; 
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+// Order of cell values for range predicates and ordered indexes. Cells that
+// are integers (an optional '-' and digits) compare by numeric value and sort
+// before all other cells, which compare bytewise. Integers of equal value
+// but different text, such as '010' and '10', compare bytewise too, so only
+// equal cells tie, as they do under `=`.
+int compareValues(string_view a, string_view b);
+
+// Byte string whose memcmp order is the compareValues order of the values.
+// Encodings are prefix-free, so one can be followed by another to build a
+// composite key that sorts by its first part, then its second.
+string encodeOrderedKey(string_view value);
+
+// Type a column is declared with in schema.json. Untyped columns, the pk
+// among them, hold any text and order it with compareValues. Cells of every
+// type are kept as their canonical text in rows; an empty cell is a null.
+enum class ColumnType { Untyped, Int64, Double, Bool, Text, Timestamp };
+
+bool parseColumnType(const string& name, ColumnType& type);
+const char* columnTypeName(ColumnType type);
+
+// Sets out to the canonical text of value as a cell of type: integers and
+// doubles in their shortest form, bools as true or false, timestamps as
+// YYYY-MM-DD HH:MM:SS. False when value is not one.
+bool canonicalValue(ColumnType type, string_view value, string& out);
+
+// Order of two canonical cells of type. Typed nulls sort first; int64 and
+// double compare by value, the other types bytewise. Range predicates do
+// not order nulls at all and never match them.
+int compareCells(ColumnType type, string_view a, string_view b);
+
+// encodeOrderedKey for cells of type, in compareCells order.
+string encodeOrderedKey(ColumnType type, string_view value);
+
+// Bytes per cell when type is stored in binary in a columnar segment; 0 for
+// types kept as text.
+size_t binaryWidth(ColumnType type);
+// Appends the binary form of a cell; false when it has none, because it is
+// null or not canonical.
+bool encodeBinary(ColumnType type, string_view value, string& out);
+void decodeBinary(ColumnType type, const char* data, string& out);
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include "../adt/Array.hpp"
+#include "../adt/Queue.hpp"
+
+using namespace std;
+
+// Fixed set of threads draining a bounded task queue. tryPost refuses new
+// work once maxQueued tasks are waiting, so callers can hold requests back
+// instead of letting the backlog grow without limit.
+class WorkerPool {
+public:
+    WorkerPool(size_t threads, size_t maxQueued);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    bool tryPost(function<void()> task);
+
+private:
+    void workerLoop();
+
+    Array<thread> workers;
+    Queue<function<void()>> tasks;
+    size_t maxQueued;
+    mutex mtx;
+    condition_variable available;
+    bool stopping = false;
+};
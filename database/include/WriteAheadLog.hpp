@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <filesystem>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include "../adt/Array.hpp"
+
+using namespace std;
+
+// When appended records reach stable storage:
+//   Always   - fdatasync before append returns, once per (group) commit
+//   Interval - a background thread syncs every interval; a crash can lose
+//              the commits of the last interval
+//   Os       - never synced explicitly, the kernel writes back on its own
+enum class WalSyncMode { Always, Interval, Os };
+
+WalSyncMode parseWalSyncMode(const string& name);
+
+struct WalRecord {
+    enum class Kind : char { Insert = 'I', Delete = 'D' };
+
+    Kind kind = Kind::Insert;
+    string table;
+    // Insert: complete rows, primary key first. Delete: removed primary keys.
+    Array<Array<string>> rows;
+    Array<string> keys;
+};
+
+// Append-only redo log shared by all tables of a database. Each record is
+// framed by its length and a CRC32, so a write torn by a crash is detected
+// and everything from it onwards is ignored on replay.
+class WriteAheadLog {
+public:
+    WriteAheadLog(const filesystem::path& path, WalSyncMode mode, size_t intervalMs);
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    void append(const WalRecord& record);
+    Array<WalRecord> readAll() const;
+    // Empties the log once everything it covers is durable in the tables.
+    void truncate();
+    size_t getSize() const;
+
+private:
+    void syncLoop();
+
+    string path;
+    int fd = -1;
+    WalSyncMode mode;
+    chrono::milliseconds interval;
+
+    mutable mutex mtx;
+    size_t size = 0;
+    bool dirty = false;
+    bool stopping = false;
+    condition_variable stopSignal;
+    thread syncer;
+};
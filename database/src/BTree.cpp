@@ -0,0 +1,471 @@
+#include "BTree.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+
+namespace {
+
+const char HEADER_MAGIC[] = "DBBTREE1";
+const size_t NODE_HEADER = 16;
+const size_t SLOT_SIZE = 16;
+const size_t CHILD_BYTES = 4;
+
+uint64_t getInt(const char* data, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i) {
+        value |= static_cast<uint64_t>(static_cast<unsigned char>(data[i])) << (8 * i);
+    }
+    return value;
+}
+
+void setInt(char* data, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        data[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+}
+
+// First 8 key bytes as a big-endian integer, zero padded, so integer order
+// agrees with memcmp order wherever the prefixes differ.
+uint64_t keyPrefix(string_view key) {
+    uint64_t prefix = 0;
+    for (size_t i = 0; i < 8; ++i) {
+        prefix <<= 8;
+        if (i < key.size()) prefix |= static_cast<unsigned char>(key[i]);
+    }
+    return prefix;
+}
+
+bool isLeaf(const char* page) { return page[0] != 0; }
+size_t countOf(const char* page) { return getInt(page + 2, 2); }
+size_t heapStart(const char* page) { return getInt(page + 4, 2); }
+size_t garbageOf(const char* page) { return getInt(page + 6, 2); }
+size_t linkOf(const char* page) { return getInt(page + 8, 4); }
+void setLink(char* page, size_t link) { setInt(page + 8, link, 4); }
+
+const char* slotAt(const char* page, size_t i) { return page + NODE_HEADER + i * SLOT_SIZE; }
+
+string_view keyAt(const char* page, size_t i) {
+    const char* slot = slotAt(page, i);
+    return string_view(page + getInt(slot + 8, 2), getInt(slot + 10, 2));
+}
+
+string_view payloadAt(const char* page, size_t i) {
+    const char* slot = slotAt(page, i);
+    return string_view(page + getInt(slot + 8, 2) + getInt(slot + 10, 2), getInt(slot + 12, 2));
+}
+
+size_t childAt(const char* page, size_t i) {
+    return getInt(payloadAt(page, i).data(), CHILD_BYTES);
+}
+
+void initNode(char* page, bool leaf, size_t link) {
+    memset(page, 0, NODE_HEADER);
+    page[0] = leaf ? 1 : 0;
+    setInt(page + 4, BTree::PAGE_SIZE, 2);
+    setLink(page, link);
+}
+
+size_t freeSpace(const char* page) {
+    return heapStart(page) - NODE_HEADER - countOf(page) * SLOT_SIZE;
+}
+
+int compareSlot(const char* page, size_t i, uint64_t prefix, string_view key) {
+    uint64_t slotPrefix = getInt(slotAt(page, i), 8);
+    if (slotPrefix != prefix) return slotPrefix < prefix ? -1 : 1;
+    return keyAt(page, i).compare(key);
+}
+
+// First slot whose key is >= key (or > key when strict).
+size_t searchNode(const char* page, string_view key, bool strict) {
+    uint64_t prefix = keyPrefix(key);
+    size_t low = 0;
+    size_t high = countOf(page);
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        int order = compareSlot(page, middle, prefix, key);
+        if (order < 0 || (strict && order == 0)) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+// Child of an inner node that holds key.
+size_t childFor(const char* page, string_view key) {
+    size_t i = searchNode(page, key, true);
+    return i == 0 ? linkOf(page) : childAt(page, i - 1);
+}
+
+// Assumes freeSpace covers the slot and the bytes.
+void insertEntry(char* page, size_t i, string_view key, string_view payload) {
+    size_t count = countOf(page);
+    size_t start = heapStart(page) - key.size() - payload.size();
+    memcpy(page + start, key.data(), key.size());
+    memcpy(page + start + key.size(), payload.data(), payload.size());
+    char* slot = page + NODE_HEADER + i * SLOT_SIZE;
+    memmove(slot + SLOT_SIZE, slot, (count - i) * SLOT_SIZE);
+    uint64_t prefix = keyPrefix(key);
+    setInt(slot, prefix, 8);
+    setInt(slot + 8, start, 2);
+    setInt(slot + 10, key.size(), 2);
+    setInt(slot + 12, payload.size(), 2);
+    setInt(slot + 14, 0, 2);
+    setInt(page + 2, count + 1, 2);
+    setInt(page + 4, start, 2);
+}
+
+void removeEntry(char* page, size_t i) {
+    size_t count = countOf(page);
+    size_t bytes = keyAt(page, i).size() + payloadAt(page, i).size();
+    char* slot = page + NODE_HEADER + i * SLOT_SIZE;
+    memmove(slot, slot + SLOT_SIZE, (count - i - 1) * SLOT_SIZE);
+    setInt(page + 2, count - 1, 2);
+    setInt(page + 6, garbageOf(page) + bytes, 2);
+}
+
+// Entries of a node in order, for rewriting it.
+struct Entries {
+    Array<string> keys;
+    Array<string> payloads;
+};
+
+Entries readEntries(const char* page) {
+    Entries entries;
+    for (size_t i = 0; i < countOf(page); ++i) {
+        entries.keys.append(string(keyAt(page, i)));
+        entries.payloads.append(string(payloadAt(page, i)));
+    }
+    return entries;
+}
+
+void writeEntries(char* page, bool leaf, size_t link, const Entries& entries, size_t from, size_t to) {
+    initNode(page, leaf, link);
+    for (size_t i = from; i < to; ++i) {
+        insertEntry(page, i - from, entries.keys.at(i), entries.payloads.at(i));
+    }
+}
+
+// Drops the bytes of removed entries.
+void compactNode(char* page) {
+    Entries entries = readEntries(page);
+    writeEntries(page, isLeaf(page), linkOf(page), entries, 0, entries.keys.getSize());
+}
+
+string childBytes(size_t child) {
+    string bytes(CHILD_BYTES, '\0');
+    setInt(&bytes[0], child, CHILD_BYTES);
+    return bytes;
+}
+
+}
+
+BTree::Pin::Pin(BTree& tree, size_t page) : frame(&tree.fetch(page)) {
+    frame->pins++;
+}
+
+BTree::Pin::~Pin() {
+    frame->pins--;
+}
+
+void BTree::Pin::markDirty() {
+    frame->dirty = true;
+}
+
+BTree::BTree(const filesystem::path& file, size_t cachePages) : file(file), cachePages(cachePages < 8 ? 8 : cachePages) {
+    fd = ::open(file.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw runtime_error("Cannot open " + file.string() + ": " + strerror(errno));
+    }
+    // Frames are never reallocated, so a pinned frame stays put.
+    for (size_t i = 0; i < this->cachePages; ++i) {
+        frames.append(Frame());
+    }
+}
+
+BTree::~BTree() {
+    if (fd >= 0) close(fd);
+}
+
+bool BTree::open(uint64_t tag) {
+    lock_guard<mutex> guard(access);
+    char header[PAGE_SIZE];
+    ssize_t n = pread(fd, header, PAGE_SIZE, 0);
+    if (n == static_cast<ssize_t>(PAGE_SIZE) && memcmp(header, HEADER_MAGIC, 8) == 0 && header[8] == 1 &&
+        getInt(header + 9, 8) == tag) {
+        root = getInt(header + 17, 4);
+        pageCount = getInt(header + 21, 4);
+        off_t size = lseek(fd, 0, SEEK_END);
+        if (root > 0 && root < pageCount && size >= static_cast<off_t>(pageCount * PAGE_SIZE)) {
+            cleanOnDisk = true;
+            return true;
+        }
+    }
+    reset();
+    return false;
+}
+
+void BTree::clear() {
+    lock_guard<mutex> guard(access);
+    reset();
+}
+
+// Starts the file over with an empty root leaf.
+void BTree::reset() {
+    for (size_t i = 0; i < frames.getSize(); ++i) {
+        Frame& frame = frames.at(i);
+        if (frame.page != 0) frameOfPage.remove(frame.page);
+        frame.page = 0;
+        frame.dirty = false;
+        frame.pins = 0;
+    }
+    if (ftruncate(fd, 0) != 0) {
+        throw runtime_error("Cannot truncate " + file.string() + ": " + strerror(errno));
+    }
+    cleanOnDisk = true;
+    beginChange();
+    pageCount = 1;
+    root = allocatePage(true);
+}
+
+void BTree::insert(string_view key, string_view payload) {
+    if (key.size() + payload.size() > MAX_ENTRY_BYTES) {
+        throw runtime_error("Key too long for a B+tree index");
+    }
+    lock_guard<mutex> guard(access);
+    beginChange();
+    Split split = insertInto(root, key, payload);
+    if (!split.happened) return;
+    size_t newRoot = allocatePage(false);
+    Pin pin(*this, newRoot);
+    setLink(pin.data(), root);
+    insertEntry(pin.data(), 0, split.separator, childBytes(split.page));
+    root = newRoot;
+}
+
+BTree::Split BTree::insertInto(size_t page, string_view key, string_view payload) {
+    Pin pin(*this, page);
+    char* node = pin.data();
+    if (!isLeaf(node)) {
+        Split below = insertInto(childFor(node, key), key, payload);
+        if (!below.happened) return Split();
+        return place(pin, below.separator, childBytes(below.page));
+    }
+    size_t i = searchNode(node, key, false);
+    if (i < countOf(node) && keyAt(node, i) == key) {
+        removeEntry(node, i);
+    }
+    return place(pin, key, payload);
+}
+
+// Adds an entry to a pinned node, splitting it in two when it is full. A
+// leaf split copies the first key of the new right leaf up; an inner split
+// moves its middle key up and makes that key's child the right node's link.
+BTree::Split BTree::place(Pin& pin, string_view key, string_view payload) {
+    char* node = pin.data();
+    bool leaf = isLeaf(node);
+    pin.markDirty();
+    size_t need = SLOT_SIZE + key.size() + payload.size();
+    if (freeSpace(node) < need && freeSpace(node) + garbageOf(node) >= need) {
+        compactNode(node);
+    }
+    size_t i = searchNode(node, key, false);
+    if (freeSpace(node) >= need) {
+        insertEntry(node, i, key, payload);
+        return Split();
+    }
+
+    Entries entries = readEntries(node);
+    entries.keys.append(string());
+    entries.payloads.append(string());
+    for (size_t j = entries.keys.getSize() - 1; j > i; --j) {
+        entries.keys.at(j) = std::move(entries.keys.at(j - 1));
+        entries.payloads.at(j) = std::move(entries.payloads.at(j - 1));
+    }
+    entries.keys.at(i) = string(key);
+    entries.payloads.at(i) = string(payload);
+
+    // Halves of about the same size in bytes.
+    size_t count = entries.keys.getSize();
+    size_t total = 0;
+    for (size_t j = 0; j < count; ++j) {
+        total += SLOT_SIZE + entries.keys.at(j).size() + entries.payloads.at(j).size();
+    }
+    size_t middle = 0;
+    size_t bytes = 0;
+    while (middle + 2 < count && bytes < total / 2) {
+        bytes += SLOT_SIZE + entries.keys.at(middle).size() + entries.payloads.at(middle).size();
+        middle++;
+    }
+    if (middle == 0) middle = 1;
+
+    Split split;
+    split.happened = true;
+    split.separator = entries.keys.at(middle);
+    split.page = allocatePage(leaf);
+    Pin right(*this, split.page);
+    right.markDirty();
+    if (leaf) {
+        writeEntries(right.data(), true, linkOf(node), entries, middle, count);
+        writeEntries(node, true, split.page, entries, 0, middle);
+    } else {
+        size_t child = getInt(entries.payloads.at(middle).data(), CHILD_BYTES);
+        writeEntries(right.data(), false, child, entries, middle + 1, count);
+        writeEntries(node, false, linkOf(node), entries, 0, middle);
+    }
+    return split;
+}
+
+bool BTree::remove(string_view key) {
+    lock_guard<mutex> guard(access);
+    beginChange();
+    Pin pin(*this, findLeaf(key));
+    size_t i = searchNode(pin.data(), key, false);
+    if (i >= countOf(pin.data()) || keyAt(pin.data(), i) != key) return false;
+    removeEntry(pin.data(), i);
+    pin.markDirty();
+    return true;
+}
+
+size_t BTree::findLeaf(string_view key) {
+    size_t page = root;
+    while (true) {
+        Pin pin(*this, page);
+        if (isLeaf(pin.data())) return page;
+        page = childFor(pin.data(), key);
+    }
+}
+
+void BTree::scan(const string* from, const string* to, const function<bool(string_view, string_view)>& visit) {
+    lock_guard<mutex> guard(access);
+    size_t page = from != nullptr ? findLeaf(*from) : root;
+    if (from == nullptr) {
+        while (true) {
+            Pin pin(*this, page);
+            if (isLeaf(pin.data())) break;
+            page = linkOf(pin.data());
+        }
+    }
+    size_t i = 0;
+    if (from != nullptr) {
+        Pin pin(*this, page);
+        i = searchNode(pin.data(), *from, false);
+    }
+    while (page != 0) {
+        Pin pin(*this, page);
+        const char* node = pin.data();
+        for (; i < countOf(node); ++i) {
+            string_view key = keyAt(node, i);
+            if (to != nullptr && key.compare(*to) >= 0) return;
+            if (!visit(key, payloadAt(node, i))) return;
+        }
+        page = linkOf(node);
+        i = 0;
+    }
+}
+
+void BTree::save(uint64_t tag) {
+    lock_guard<mutex> guard(access);
+    for (size_t i = 0; i < frames.getSize(); ++i) {
+        if (frames.at(i).page != 0 && frames.at(i).dirty) writeFrame(frames.at(i));
+    }
+    if (fsync(fd) != 0) {
+        throw runtime_error("Cannot sync " + file.string() + ": " + strerror(errno));
+    }
+    writeHeader(true, tag);
+    cleanOnDisk = true;
+}
+
+// The clean header goes before any page is changed, so a crash between
+// saves leaves a file that open rejects.
+void BTree::beginChange() {
+    if (!cleanOnDisk) return;
+    writeHeader(false, 0);
+    cleanOnDisk = false;
+}
+
+void BTree::writeHeader(bool clean, uint64_t tag) {
+    char header[PAGE_SIZE];
+    memset(header, 0, PAGE_SIZE);
+    memcpy(header, HEADER_MAGIC, 8);
+    header[8] = clean ? 1 : 0;
+    setInt(header + 9, tag, 8);
+    setInt(header + 17, root, 4);
+    setInt(header + 21, pageCount, 4);
+    if (pwrite(fd, header, PAGE_SIZE, 0) != static_cast<ssize_t>(PAGE_SIZE) || fsync(fd) != 0) {
+        throw runtime_error("Cannot write " + file.string() + ": " + strerror(errno));
+    }
+}
+
+size_t BTree::allocatePage(bool leaf) {
+    size_t page = pageCount++;
+    Pin pin(*this, page);
+    initNode(pin.data(), leaf, 0);
+    pin.markDirty();
+    return page;
+}
+
+// Clock replacement over the unpinned frames.
+BTree::Frame& BTree::fetch(size_t page) {
+    const size_t* cached = frameOfPage.getPointer(page);
+    if (cached != nullptr) {
+        Frame& frame = frames.at(*cached);
+        frame.referenced = true;
+        return frame;
+    }
+
+    size_t victim = frames.getSize();
+    for (size_t step = 0; step < 2 * frames.getSize() && victim == frames.getSize(); ++step) {
+        size_t candidate = clockHand;
+        clockHand = (clockHand + 1) % frames.getSize();
+        Frame& frame = frames.at(candidate);
+        if (frame.page == 0) {
+            victim = candidate;
+        } else if (frame.pins == 0) {
+            if (frame.referenced) {
+                frame.referenced = false;
+            } else {
+                victim = candidate;
+            }
+        }
+    }
+    if (victim == frames.getSize()) {
+        throw runtime_error("B+tree page cache of " + file.string() + " is full");
+    }
+
+    Frame& frame = frames.at(victim);
+    if (frame.page != 0) {
+        if (frame.dirty) writeFrame(frame);
+        frameOfPage.remove(frame.page);
+    }
+    if (!frame.data) frame.data = make_unique<char[]>(PAGE_SIZE);
+    ssize_t n = pread(fd, frame.data.get(), PAGE_SIZE, static_cast<off_t>(page * PAGE_SIZE));
+    if (n < 0) {
+        throw runtime_error("Cannot read " + file.string() + ": " + strerror(errno));
+    }
+    memset(frame.data.get() + n, 0, PAGE_SIZE - static_cast<size_t>(n));
+    frame.page = page;
+    frame.dirty = false;
+    frame.referenced = true;
+    frame.pins = 0;
+    frameOfPage.insert(page, victim);
+    return frame;
+}
+
+void BTree::writeFrame(Frame& frame) {
+    size_t written = 0;
+    while (written < PAGE_SIZE) {
+        ssize_t n = pwrite(fd, frame.data.get() + written, PAGE_SIZE - written,
+                           static_cast<off_t>(frame.page * PAGE_SIZE + written));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            throw runtime_error("Cannot write " + file.string() + ": " + strerror(errno));
+        }
+        written += static_cast<size_t>(n);
+    }
+    frame.dirty = false;
+}
@@ -0,0 +1,42 @@
+#include "Compactor.hpp"
+#include <iostream>
+#include <chrono>
+
+
+Compactor::Compactor(Database& db, const CompactorConfig& config) : db(db), config(config) {
+    if (config.intervalSeconds > 0) {
+        worker = thread(&Compactor::run, this);
+    }
+}
+
+Compactor::~Compactor() {
+    {
+        lock_guard<mutex> lock(mtx);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (worker.joinable()) worker.join();
+}
+
+void Compactor::run() {
+    unique_lock<mutex> lock(mtx);
+    while (!stopping) {
+        wake.wait_for(lock, chrono::seconds(config.intervalSeconds));
+        if (stopping) break;
+        lock.unlock();
+
+        Array<string> names = db.getTableNames();
+        for (size_t i = 0; i < names.getSize(); ++i) {
+            try {
+                CompactionStats stats = db.getTable(names.at(i)).compact(config.bytesPerSecond);
+                if (stats.segmentsMerged == 0) continue;
+                cout << "Компактификация " << names.at(i) << ": сегментов " << stats.segmentsMerged
+                     << " -> " << stats.segmentsWritten << ", удалено строк " << stats.rowsDropped
+                     << ", записано " << stats.bytesWritten / 1024 << " КБ" << endl;
+            } catch (const exception& e) {
+                cerr << "Ошибка компактификации " << names.at(i) << ": " << e.what() << "\n";
+            }
+        }
+        lock.lock();
+    }
+}
@@ -0,0 +1,196 @@
+#include "Csv.hpp"
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+
+namespace {
+
+const size_t BLOCK_SIZE = 64;
+
+uint64_t maskScalar(const char* p) {
+    uint64_t mask = 0;
+    for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+        if (p[i] == ',' || p[i] == '"' || p[i] == '\n') mask |= uint64_t(1) << i;
+    }
+    return mask;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("sse2")))
+uint64_t maskSse2(const char* p) {
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i newline = _mm_set1_epi8('\n');
+    uint64_t mask = 0;
+    for (size_t i = 0; i < BLOCK_SIZE; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, comma), _mm_cmpeq_epi8(chunk, quote)),
+                                    _mm_cmpeq_epi8(chunk, newline));
+        mask |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(hits))) << i;
+    }
+    return mask;
+}
+
+__attribute__((target("avx2")))
+uint64_t maskAvx2(const char* p) {
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    uint64_t mask = 0;
+    for (size_t i = 0; i < BLOCK_SIZE; i += 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        __m256i hits = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, comma), _mm256_cmpeq_epi8(chunk, quote)),
+                                       _mm256_cmpeq_epi8(chunk, newline));
+        mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(hits))) << i;
+    }
+    return mask;
+}
+
+using MaskFunction = uint64_t (*)(const char*);
+
+MaskFunction selectMask() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return maskAvx2;
+    if (__builtin_cpu_supports("sse2")) return maskSse2;
+    return maskScalar;
+}
+
+const MaskFunction blockMask = selectMask();
+
+#else
+
+const auto blockMask = maskScalar;
+
+#endif
+
+bool needsQuoting(string_view value) {
+    for (char c : value) {
+        if (c == ',' || c == '"' || c == '\n' || c == '\r') return true;
+    }
+    return false;
+}
+
+}
+
+uint64_t findCsvSpecials(const char* p, size_t length) {
+    if (length >= BLOCK_SIZE) return blockMask(p);
+    // The tail of a buffer goes through a padded copy so the wide loads
+    // never read past its end.
+    char padded[BLOCK_SIZE] = {};
+    memcpy(padded, p, length);
+    return blockMask(padded) & ((uint64_t(1) << length) - 1);
+}
+
+CsvCursor::CsvCursor(string_view text) : p(text.data()), end(text.data() + text.size()) {}
+
+bool CsvCursor::next(Array<string>& row, size_t offset, size_t width) {
+    return parseRecord(&row, offset, width);
+}
+
+bool CsvCursor::skip() {
+    return parseRecord(nullptr, 0, 0);
+}
+
+const char* CsvCursor::position() const {
+    return p;
+}
+
+bool CsvCursor::parseRecord(Array<string>* row, size_t offset, size_t width) {
+    while (p < end && (*p == '\n' || (*p == '\r' && p + 1 < end && p[1] == '\n'))) {
+        p += *p == '\n' ? 1 : 2;
+    }
+    if (p >= end) return false;
+
+    bool recordEnd = false;
+    size_t field = 0;
+    while (!recordEnd) {
+        string* cell = row != nullptr && field < width ? &row->at(offset + field) : nullptr;
+        parseField(cell, recordEnd);
+        field++;
+    }
+    for (; row != nullptr && field < width; ++field) {
+        row->at(offset + field).clear();
+    }
+    return true;
+}
+
+// Reads one field starting at p and leaves p after its terminator; sets
+// recordEnd when that was the end of the record.
+void CsvCursor::parseField(string* cell, bool& recordEnd) {
+    if (p < end && *p == '"') {
+        if (cell != nullptr) cell->clear();
+        ++p;
+        while (p < end) {
+            const char* quote = static_cast<const char*>(memchr(p, '"', end - p));
+            const char* stop = quote != nullptr ? quote : end;
+            if (cell != nullptr) cell->append(p, stop - p);
+            p = stop;
+            if (p >= end) break;
+            if (p + 1 < end && p[1] == '"') {
+                if (cell != nullptr) *cell += '"';
+                p += 2;
+                continue;
+            }
+            ++p;
+            break;
+        }
+        // Anything between the closing quote and the separator is dropped.
+        while (p < end && *p != ',' && *p != '\n') ++p;
+    } else {
+        const char* start = p;
+        while (true) {
+            p = nextSpecial();
+            // A stray quote inside an unquoted field is data.
+            if (p < end && *p == '"') {
+                ++p;
+                continue;
+            }
+            break;
+        }
+        const char* stop = p;
+        if ((p >= end || *p == '\n') && stop > start && stop[-1] == '\r') --stop;
+        if (cell != nullptr) cell->assign(start, stop - start);
+    }
+    if (p >= end || *p == '\n') recordEnd = true;
+    if (p < end) ++p;
+}
+
+// First structural character at or after p, or end.
+const char* CsvCursor::nextSpecial() {
+    while (true) {
+        if (p < block || p >= block + BLOCK_SIZE) {
+            if (p >= end) return end;
+            block = p;
+            mask = findCsvSpecials(block, static_cast<size_t>(end - block));
+        }
+        size_t skipped = static_cast<size_t>(p - block);
+        if (skipped > 0) mask &= ~uint64_t(0) << skipped;
+        if (mask != 0) return block + __builtin_ctzll(mask);
+        p = block + BLOCK_SIZE;
+    }
+}
+
+void splitCsvLine(string_view line, Array<string>& row, size_t offset, size_t width) {
+    CsvCursor cursor(line);
+    if (!cursor.next(row, offset, width)) {
+        for (size_t c = 0; c < width; ++c) {
+            row.at(offset + c).clear();
+        }
+    }
+}
+
+void appendCsvField(string& out, string_view value) {
+    if (!needsQuoting(value)) {
+        out.append(value.data(), value.size());
+        return;
+    }
+    out += '"';
+    for (char c : value) {
+        if (c == '"') out += '"';
+        out += c;
+    }
+    out += '"';
+}
@@ -1,14 +1,17 @@
 #include "Database.hpp"
 #include <filesystem>
 #include <fstream>
-#include <thread>
-#include <chrono>
+#include <stdexcept>
 
 
 Database::Database(const Schema& schema) : schema(schema) {
     initializeStorage();
     lockFile = filesystem::path(schema.name) / ".db_lock";
     lock();
+    wal = make_shared<WriteAheadLog>(filesystem::path(schema.name) / "wal.log",
+                                     parseWalSyncMode(schema.walSync), schema.walSyncIntervalMs);
+    indexCatalogFile = filesystem::path(schema.name) / "indexes.json";
+    loadIndexCatalog();
     
     Array<string> table_names = schema.getTableNames(); 
     for(size_t i = 0; i < table_names.getSize(); ++i) {
@@ -20,31 +23,152 @@ Database::Database(const Schema& schema) : schema(schema) {
         config.tuplesLimit = schema.tuplesLimit;
         config.basePath = filesystem::path(schema.name) / tableName;
         config.columns = tableColumns;
+        const Array<ColumnType>* types = schema.columnTypes.getPointer(tableName);
+        if (types != nullptr) config.types = *types;
+        config.wal = wal;
+        config.columnar = schema.storage == "columnar";
+        const Array<string>* bloomColumns = schema.bloomFilters.getPointer(tableName);
+        if (bloomColumns != nullptr) config.bloomColumns = *bloomColumns;
+        config.bloomFalsePositiveRate = schema.bloomFalsePositiveRate;
+        const Array<IndexDefinition>* indexed = indexCatalog.getPointer(tableName);
+        if (indexed != nullptr) config.indexes = *indexed;
         tables.insert(tableName, Table(config));
     }
+    recover();
 }
 
 Database::~Database() {
+    try {
+        checkpoint();
+    } catch (const exception&) {
+        // The WAL is still intact and gets replayed on the next start.
+    }
+    wal.reset();
     unlock();
 }
 
-void Database::lock() {
-    int retries = 0;
-    while (filesystem::exists(lockFile)) {
-        this_thread::sleep_for(chrono::milliseconds(100));
-        retries++;
-        if (retries > 50) {
-            throw runtime_error("Database is locked by another process");
+void Database::recover() {
+    Array<WalRecord> records = wal->readAll();
+    if (records.empty()) {
+        if (wal->getSize() > 0) wal->truncate();
+        return;
+    }
+    Array<string> names = tables.getAllKeys();
+    for (size_t t = 0; t < names.getSize(); ++t) {
+        Array<const WalRecord*> tableRecords;
+        for (size_t i = 0; i < records.getSize(); ++i) {
+            if (records.at(i).table == names.at(t)) {
+                tableRecords.append(&records.at(i));
+            }
         }
+        getTable(names.at(t)).recover(tableRecords);
     }
-    ofstream f(lockFile);
-    f << "locked";
+    checkpoint();
 }
 
-void Database::unlock() {
-    if (filesystem::exists(lockFile)) {
-        filesystem::remove(lockFile);
+void Database::checkpoint() {
+    Array<string> names = tables.getAllKeys();
+    names.sort([](const string& a, const string& b) { return a < b; });
+    Array<unique_lock<shared_mutex>> writeLocks;
+    for (size_t i = 0; i < names.getSize(); ++i) {
+        writeLocks.append(getTable(names.at(i)).lockForWrite());
+    }
+    for (size_t i = 0; i < names.getSize(); ++i) {
+        getTable(names.at(i)).syncToDisk();
+    }
+    wal->truncate();
+}
+
+void Database::checkpointIfNeeded() {
+    if (wal->getSize() >= WAL_CHECKPOINT_BYTES) {
+        checkpoint();
+    }
+}
+
+void Database::createIndex(const string& table, const IndexDefinition& definition) {
+    lock_guard<mutex> guard(catalogLock);
+    getTable(table).createIndex(definition);
+    Array<IndexDefinition>* indexed = indexCatalog.getPointer(table);
+    if (indexed == nullptr) {
+        indexCatalog.insert(table, Array<IndexDefinition>());
+        indexed = indexCatalog.getPointer(table);
+    }
+    indexed->append(definition);
+    saveIndexCatalog();
+}
+
+// The catalog entry goes first: an index file left behind by a crash is
+// never loaded without it.
+void Database::dropIndex(const string& table, const string& column) {
+    lock_guard<mutex> guard(catalogLock);
+    Array<IndexDefinition>* indexed = indexCatalog.getPointer(table);
+    for (size_t i = 0; indexed != nullptr && i < indexed->getSize(); ++i) {
+        if (indexed->at(i).column != column) continue;
+        indexed->removeAt(i);
+        saveIndexCatalog();
+        break;
+    }
+    getTable(table).dropIndex(column);
+}
+
+void Database::loadIndexCatalog() {
+    ifstream f(indexCatalogFile);
+    if (!f.is_open()) return;
+    json j;
+    f >> j;
+    // {"table": [{"column": "name", "type": "hash" | "btree"}, ...]}; a bare
+    // column name is a hash index.
+    for (auto& [table, entries] : j.items()) {
+        Array<IndexDefinition> indexed;
+        for (const auto& entry : entries) {
+            IndexDefinition definition;
+            if (entry.is_string()) {
+                definition.column = entry.get<string>();
+            } else {
+                definition.column = entry.at("column").get<string>();
+                definition.ordered = entry.value("type", string("hash")) == "btree";
+            }
+            indexed.append(definition);
+        }
+        indexCatalog.insert(table, indexed);
+    }
+}
+
+void Database::saveIndexCatalog() {
+    json j = json::object();
+    Array<string> names = indexCatalog.getAllKeys();
+    for (size_t i = 0; i < names.getSize(); ++i) {
+        const Array<IndexDefinition>& indexed = indexCatalog.at(names.at(i));
+        if (indexed.empty()) continue;
+        json entries = json::array();
+        for (size_t c = 0; c < indexed.getSize(); ++c) {
+            entries.push_back({{"column", indexed.at(c).column}, {"type", indexed.at(c).ordered ? "btree" : "hash"}});
+        }
+        j[names.at(i)] = entries;
+    }
+    filesystem::path tmp = indexCatalogFile;
+    tmp += ".tmp";
+    {
+        ofstream f(tmp, ios::trunc);
+        f << j.dump(2) << "\n";
+        f.flush();
+        if (!f) throw runtime_error("Failed to write " + indexCatalogFile.string());
     }
+    filesystem::rename(tmp, indexCatalogFile);
+}
+
+// The lock is held for the lifetime of the process that opened the
+// database and released by the kernel if that process dies.
+void Database::lock() {
+    fileLock = make_unique<FileLock>(lockFile);
+    if (!fileLock->tryLock()) {
+        fileLock.reset();
+        throw runtime_error("Database is locked by another process");
+    }
+}
+
+void Database::unlock() {
+    fileLock.reset();
 }
 
 Table& Database::getTable(const string& name) {
@@ -0,0 +1,653 @@
+#include "Executor.hpp"
+#include "Query.hpp"
+#include "Row.hpp"
+#include "Csv.hpp"
+#include "Value.hpp"
+#include <fstream>
+#include <functional>
+
+
+namespace {
+
+// One level of the SELECT pipeline. The first step streams its table from
+// disk; every later step reads its table once into memory and, when the WHERE
+// clause links it to an earlier table by `a = b`, indexes those rows by the
+// join column so each outer row probes instead of rescanning.
+//
+// Conjuncts that only reference this step's table are scan filters: they run
+// as the table is read, so failing rows are never streamed further or stored.
+// Join filters reference earlier tables too and run once this row is loaded.
+struct JoinStep {
+    size_t table = 0;
+    Array<Predicate> scanFilters;
+    Array<Predicate> joinFilters;
+    Array<string> cells;
+    size_t rowCount = 0;
+    bool hashed = false;
+    size_t buildColumn = 0;
+    size_t probeSlot = 0;
+    ChainingHashTable<string, Array<size_t>> buckets;
+    // Set when scan filters limit an indexed column to a constant or a
+    // range; the table is then read through that index.
+    bool indexed = false;
+    ColumnRange range;
+    // Every comparison of a column with a constant in the scan filters,
+    // for passing over segments by their zone maps.
+    Array<ColumnRange> bounds;
+};
+
+uintmax_t estimateTableSize(const Array<Segment>& segments) {
+    uintmax_t total = 0;
+    for (size_t i = 0; i < segments.getSize(); ++i) {
+        error_code ec;
+        uintmax_t size = filesystem::file_size(segments.at(i).file, ec);
+        if (!ec) total += size;
+    }
+    return total;
+}
+
+// The rows the step reads from its table. Only the columns marked in the
+// mask need to be filled in. The caller holds the table's read lock.
+TableCursor openCursor(const JoinStep& step, const Table& table, const Array<bool>& columns) {
+    return step.indexed ? table.openLookup(step.range, columns) : table.openScan(columns, step.bounds);
+}
+
+// Calls onRow for every row of the cursor, with the cells swapped into
+// row[offset, offset + width); onRow returns false to stop. Segments the
+// cursor passes over are counted in status.
+template <typename F>
+bool scanTable(TableCursor& cursor, const Table& table, Array<string>& row, size_t offset, QueryStatus& status,
+               F&& onRow) {
+    status.zoneSkipped += cursor.getZoneSkipped();
+    status.bloomSkipped += cursor.getBloomSkipped();
+    RowBatch batch;
+    size_t width = table.getWidth();
+    while (cursor.nextBatch(batch)) {
+        for (size_t r = 0; r < batch.rows; ++r) {
+            for (size_t c = 0; c < width; ++c) {
+                row.at(offset + c).swap(batch.cell(r, c));
+            }
+            if (!onRow()) return false;
+        }
+    }
+    return true;
+}
+
+bool passes(const Array<Predicate>& filters, const Array<string>& row) {
+    for (size_t i = 0; i < filters.getSize(); ++i) {
+        if (!filters.at(i).evaluate(row)) return false;
+    }
+    return true;
+}
+
+void materialize(JoinStep& step, const Table& table, const Array<bool>& columns, Array<string>& row, size_t offset,
+                 QueryStatus& status) {
+    size_t width = table.getWidth();
+    TableCursor cursor = openCursor(step, table, columns);
+    scanTable(cursor, table, row, offset, status, [&]() {
+        if (!passes(step.scanFilters, row)) return true;
+        size_t index = step.rowCount++;
+        for (size_t c = 0; c < width; ++c) {
+            step.cells.append(row.at(offset + c));
+        }
+        if (!step.hashed) return true;
+        const string& key = row.at(offset + step.buildColumn);
+        Array<size_t>* bucket = step.buckets.getPointer(key);
+        if (bucket == nullptr) {
+            step.buckets.insert(key, Array<size_t>());
+            bucket = step.buckets.getPointer(key);
+        }
+        bucket->append(index);
+        return true;
+    });
+}
+
+// Picks the index lookup for a table from the filters that only read its
+// columns, which start at slot offset: an equality on the pk, then one on
+// another indexed column, then the bounds on the first column with an
+// ordered index. Strict bounds are looked up inclusive and left to the
+// filters.
+bool chooseRange(const Array<Predicate>& filters, const Table& table, size_t offset, ColumnRange& chosen) {
+    bool found = false;
+    for (size_t i = 0; i < filters.getSize(); ++i) {
+        ColumnRange range;
+        size_t slot = 0;
+        PredicateNode::Kind kind;
+        if (!filters.at(i).getConstantComparison(slot, kind, range.low) || kind != PredicateNode::Kind::Equals) continue;
+        range.column = slot - offset;
+        range.equality = true;
+        if (table.hasIndex(range) && (!found || range.column == 0)) {
+            chosen = range;
+            found = true;
+        }
+    }
+    if (found) return true;
+
+    for (size_t i = 0; i < filters.getSize(); ++i) {
+        size_t slot = 0;
+        PredicateNode::Kind kind;
+        string value;
+        if (!filters.at(i).getConstantComparison(slot, kind, value) || kind == PredicateNode::Kind::Equals) continue;
+        if (found && slot - offset != chosen.column) continue;
+        ColumnRange range = chosen;
+        range.column = slot - offset;
+        if (!table.hasIndex(range)) continue;
+        ColumnType type = table.getColumnTypes().at(range.column);
+        if (kind == PredicateNode::Kind::Greater || kind == PredicateNode::Kind::GreaterEqual) {
+            if (!range.hasLow || compareCells(type, value, range.low) > 0) range.low = value;
+            range.hasLow = true;
+        } else {
+            if (!range.hasHigh || compareCells(type, value, range.high) < 0) range.high = value;
+            range.hasHigh = true;
+        }
+        chosen = range;
+        found = true;
+    }
+    return found;
+}
+
+// Each comparison of a column with a constant among filters, as a range of
+// the table whose columns start at slot offset. Strict bounds are kept
+// inclusive, which only makes them looser.
+Array<ColumnRange> collectBounds(const Array<Predicate>& filters, size_t offset) {
+    Array<ColumnRange> bounds;
+    for (size_t i = 0; i < filters.getSize(); ++i) {
+        ColumnRange range;
+        size_t slot = 0;
+        PredicateNode::Kind kind;
+        string value;
+        if (!filters.at(i).getConstantComparison(slot, kind, value)) continue;
+        range.column = slot - offset;
+        if (kind == PredicateNode::Kind::Equals) {
+            range.equality = true;
+            range.low = value;
+        } else if (kind == PredicateNode::Kind::Greater || kind == PredicateNode::Kind::GreaterEqual) {
+            range.hasLow = true;
+            range.low = value;
+        } else {
+            range.hasHigh = true;
+            range.high = value;
+        }
+        bounds.append(range);
+    }
+    return bounds;
+}
+
+// Parses `<keyword> INDEX ON table ( column )` with an optional `;`, and
+// for CREATE an optional `USING HASH` or `USING BTREE` before it.
+bool parseIndexStatement(const Array<string>& tokens, string& tableName, string& column, bool* ordered = nullptr) {
+    size_t size = tokens.getSize();
+    if (size > 0 && tokens.at(size - 1) == ";") size--;
+    if (ordered != nullptr && size == 9 && tokens.at(7) == "USING") {
+        string type = tokens.at(8);
+        if (size == tokens.getSize() && !type.empty() && type.back() == ';') type.pop_back();
+        if (type != "HASH" && type != "BTREE") return false;
+        *ordered = type == "BTREE";
+        size = 7;
+    }
+    if (size != 7 || tokens.at(1) != "INDEX" || tokens.at(2) != "ON" || tokens.at(4) != "(" || tokens.at(6) != ")") {
+        return false;
+    }
+    tableName = tokens.at(3);
+    column = tokens.at(5);
+    // Accept table.column as the WHERE clause does.
+    if (column.compare(0, tableName.size() + 1, tableName + ".") == 0) {
+        column = column.substr(tableName.size() + 1);
+    }
+    return true;
+}
+
+}
+
+QueryStatus executeSelect(const Array<string>& tokens, Database& db, ostream& out) {
+    QueryStatus status;
+    size_t pos = 1;
+    Array<string> projection;
+    while (pos < tokens.getSize() && tokens.at(pos) != "FROM") {
+        if (tokens.at(pos) != ",") {
+            projection.append(tokens.at(pos));
+        }
+        pos++;
+    }
+
+    if (pos >= tokens.getSize() || tokens.at(pos) != "FROM") {
+        status.ok = false;
+        out << "Error: Expected FROM\n";
+        return status;
+    }
+    pos++;
+
+    Array<string> tableNames;
+    while (pos < tokens.getSize() && tokens.at(pos) != "WHERE") {
+        if (tokens.at(pos) != ",") {
+            tableNames.append(tokens.at(pos));
+        }
+        pos++;
+    }
+
+    Array<string> whereTokens;
+    if (pos < tokens.getSize() && tokens.at(pos) == "WHERE") {
+        pos++;
+        while (pos < tokens.getSize()) {
+            whereTokens.append(tokens.at(pos++));
+        }
+    }
+
+    for (size_t i = 0; i < tableNames.getSize(); ++i) {
+        if (!db.hasTable(tableNames.at(i))) {
+            status.ok = false;
+            out << "Error: Table " << tableNames.at(i) << " not found\n";
+            return status;
+        }
+    }
+
+    // Hold a read lock on every table while the plan is made, the inner
+    // tables are read and the outer one's cursor is opened. Each table is
+    // locked once, in name order, however often it appears in FROM.
+    Array<string> lockOrder;
+    for (size_t i = 0; i < tableNames.getSize(); ++i) {
+        bool seen = false;
+        for (size_t j = 0; j < lockOrder.getSize(); ++j) {
+            if (lockOrder.at(j) == tableNames.at(i)) seen = true;
+        }
+        if (!seen) lockOrder.append(tableNames.at(i));
+    }
+    lockOrder.sort([](const string& a, const string& b) { return a < b; });
+    Array<shared_lock<shared_mutex>> readLocks;
+    for (size_t i = 0; i < lockOrder.getSize(); ++i) {
+        readLocks.append(db.getTable(lockOrder.at(i)).lockForRead());
+    }
+
+    RowLayout layout;
+    Array<const Table*> tables;
+    Array<uintmax_t> tableSizes;
+    for (size_t i = 0; i < tableNames.getSize(); ++i) {
+        Table& table = db.getTable(tableNames.at(i));
+        layout.addTable(tableNames.at(i), table.getPkColumnName(), table.getColumns(), table.getColumnTypes());
+        tables.append(&table);
+        tableSizes.append(estimateTableSize(table.getSegments()));
+    }
+
+    Predicate where;
+    try {
+        where = Predicate::compile(whereTokens, layout.getSlots(), layout.getSlotTypes());
+    } catch (const exception& e) {
+        status.ok = false;
+        out << "Error: " << e.what() << "\n";
+        return status;
+    }
+
+    status.columns = projection.getSize();
+
+    // Unknown projected names print as NULL.
+    const size_t noSlot = layout.getWidth();
+    Array<size_t> projectionSlots;
+    for (size_t i = 0; i < projection.getSize(); ++i) {
+        size_t slot = noSlot;
+        layout.resolve(projection.at(i), slot);
+        projectionSlots.append(slot);
+    }
+
+    // Columns each table has to read: the projected ones and those the WHERE
+    // clause references. Columnar segments skip the rest on disk.
+    Array<Array<bool>> tableColumns;
+    for (size_t t = 0; t < layout.getTableCount(); ++t) {
+        Array<bool> columns;
+        for (size_t c = 0; c < layout.getTableWidth(t); ++c) {
+            columns.append(false);
+        }
+        tableColumns.append(std::move(columns));
+    }
+    Array<size_t> referencedSlots;
+    where.collectSlots(referencedSlots);
+    for (size_t i = 0; i < projectionSlots.getSize(); ++i) {
+        if (projectionSlots.at(i) != noSlot) referencedSlots.append(projectionSlots.at(i));
+    }
+    for (size_t i = 0; i < referencedSlots.getSize(); ++i) {
+        size_t t = layout.getTableOfSlot(referencedSlots.at(i));
+        tableColumns.at(t).at(referencedSlots.at(i) - layout.getTableOffset(t)) = true;
+    }
+
+    // Join order: stream the largest table, then repeatedly add the smallest
+    // table that an equality conjunct connects to the tables placed so far,
+    // falling back to the smallest remaining table as a cross product.
+    Array<Predicate> conjuncts = where.splitConjuncts();
+    Array<bool> consumed;
+    for (size_t i = 0; i < conjuncts.getSize(); ++i) {
+        consumed.append(false);
+    }
+    size_t tableCount = layout.getTableCount();
+    Array<bool> placed;
+    for (size_t t = 0; t < tableCount; ++t) {
+        placed.append(false);
+    }
+
+    Array<JoinStep> steps;
+    for (size_t t = 0; t < tableCount; ++t) {
+        steps.append(JoinStep());
+    }
+    for (size_t depth = 0; depth < tableCount; ++depth) {
+        size_t best = tableCount;
+        size_t bestConjunct = conjuncts.getSize();
+        for (size_t t = 0; t < tableCount; ++t) {
+            if (placed.at(t)) continue;
+            size_t joinConjunct = conjuncts.getSize();
+            for (size_t c = 0; depth > 0 && c < conjuncts.getSize() && joinConjunct == conjuncts.getSize(); ++c) {
+                size_t lhs = 0, rhs = 0;
+                if (consumed.at(c) || !conjuncts.at(c).getColumnEquality(lhs, rhs)) continue;
+                size_t lt = layout.getTableOfSlot(lhs);
+                size_t rt = layout.getTableOfSlot(rhs);
+                if ((lt == t && rt != t && placed.at(rt)) || (rt == t && lt != t && placed.at(lt))) {
+                    joinConjunct = c;
+                }
+            }
+            bool better = false;
+            if (best == tableCount) {
+                better = true;
+            } else if (depth == 0) {
+                better = tableSizes.at(t) > tableSizes.at(best);
+            } else if ((joinConjunct != conjuncts.getSize()) != (bestConjunct != conjuncts.getSize())) {
+                better = joinConjunct != conjuncts.getSize();
+            } else {
+                better = tableSizes.at(t) < tableSizes.at(best);
+            }
+            if (better) {
+                best = t;
+                bestConjunct = joinConjunct;
+            }
+        }
+
+        placed.at(best) = true;
+        JoinStep& step = steps.at(depth);
+        step.table = best;
+        if (bestConjunct != conjuncts.getSize()) {
+            size_t lhs = 0, rhs = 0;
+            conjuncts.at(bestConjunct).getColumnEquality(lhs, rhs);
+            size_t buildSlot = layout.getTableOfSlot(lhs) == best ? lhs : rhs;
+            step.hashed = true;
+            step.buildColumn = buildSlot - layout.getTableOffset(best);
+            step.probeSlot = buildSlot == lhs ? rhs : lhs;
+            consumed.at(bestConjunct) = true;
+        }
+    }
+
+    // Every remaining conjunct runs at the earliest step where all of the
+    // tables it references are loaded.
+    Array<size_t> depthOfTable;
+    for (size_t t = 0; t < tableCount; ++t) {
+        depthOfTable.append(0);
+    }
+    for (size_t depth = 0; depth < tableCount; ++depth) {
+        depthOfTable.at(steps.at(depth).table) = depth;
+    }
+    for (size_t i = 0; i < conjuncts.getSize() && tableCount > 0; ++i) {
+        if (consumed.at(i)) continue;
+        Array<size_t> slots;
+        conjuncts.at(i).collectSlots(slots);
+        size_t depth = 0;
+        for (size_t s = 0; s < slots.getSize(); ++s) {
+            size_t tableDepth = depthOfTable.at(layout.getTableOfSlot(slots.at(s)));
+            if (tableDepth > depth) depth = tableDepth;
+        }
+        bool singleTable = true;
+        for (size_t s = 0; s < slots.getSize(); ++s) {
+            if (layout.getTableOfSlot(slots.at(s)) != steps.at(depth).table) singleTable = false;
+        }
+        JoinStep& target = steps.at(depth);
+        if (singleTable) {
+            target.scanFilters.append(conjuncts.at(i));
+        } else {
+            target.joinFilters.append(conjuncts.at(i));
+        }
+    }
+    for (size_t depth = 0; depth < tableCount; ++depth) {
+        JoinStep& step = steps.at(depth);
+        size_t offset = layout.getTableOffset(step.table);
+        step.indexed = chooseRange(step.scanFilters, *tables.at(step.table), offset, step.range);
+        step.bounds = collectBounds(step.scanFilters, offset);
+    }
+
+    Array<string> currentRow = layout.makeRow();
+    string outputLine;
+
+    // The outer table streams from a cursor opened under the locks, which
+    // are released before any row is written: output can block on a slow
+    // client, and writers must not wait for it. Segment files that cannot
+    // be read fail the query.
+    unique_ptr<TableCursor> streamed;
+    try {
+        for (size_t depth = 1; depth < tableCount; ++depth) {
+            JoinStep& step = steps.at(depth);
+            materialize(step, *tables.at(step.table), tableColumns.at(step.table), currentRow,
+                        layout.getTableOffset(step.table), status);
+        }
+        if (tableCount > 0) {
+            const JoinStep& step = steps.at(0);
+            streamed.reset(new TableCursor(openCursor(step, *tables.at(step.table), tableColumns.at(step.table))));
+        }
+    } catch (const exception& e) {
+        status.ok = false;
+        out << "Error: " << e.what() << "\n";
+        return status;
+    }
+    readLocks = Array<shared_lock<shared_mutex>>();
+
+    function<void(size_t)> run;
+    auto loadRow = [&](const JoinStep& step, size_t index) {
+        size_t offset = layout.getTableOffset(step.table);
+        size_t width = layout.getTableWidth(step.table);
+        for (size_t c = 0; c < width; ++c) {
+            currentRow.at(offset + c) = step.cells.at(index * width + c);
+        }
+    };
+    run = [&](size_t depth) {
+        if (depth >= steps.getSize()) {
+            if (steps.empty() && !where.evaluate(currentRow)) return;
+            outputLine.clear();
+            for (size_t i = 0; i < projectionSlots.getSize(); ++i) {
+                if (i > 0) outputLine += ',';
+                size_t slot = projectionSlots.at(i);
+                if (slot != noSlot) {
+                    appendCsvField(outputLine, currentRow.at(slot));
+                } else {
+                    outputLine += "NULL";
+                }
+            }
+            outputLine += '\n';
+            out << outputLine;
+            status.rows++;
+            return;
+        }
+
+        const JoinStep& step = steps.at(depth);
+        if (depth == 0) {
+            size_t offset = layout.getTableOffset(step.table);
+            scanTable(*streamed, *tables.at(step.table), currentRow, offset, status, [&]() {
+                if (passes(step.scanFilters, currentRow) && passes(step.joinFilters, currentRow)) {
+                    run(depth + 1);
+                }
+                // Stop scanning once the client side of the stream has failed.
+                return out.good();
+            });
+        } else if (step.hashed) {
+            const Array<size_t>* matches = step.buckets.getPointer(currentRow.at(step.probeSlot));
+            if (matches == nullptr) return;
+            for (size_t i = 0; i < matches->getSize(); ++i) {
+                loadRow(step, matches->at(i));
+                if (passes(step.joinFilters, currentRow)) run(depth + 1);
+            }
+        } else {
+            for (size_t i = 0; i < step.rowCount; ++i) {
+                loadRow(step, i);
+                if (passes(step.joinFilters, currentRow)) run(depth + 1);
+            }
+        }
+    };
+
+    try {
+        run(0);
+    } catch (const exception& e) {
+        status.ok = false;
+        out << "Error: " << e.what() << "\n";
+    }
+    return status;
+}
+
+QueryStatus executeInsert(const Array<string>& tokens, Database& db, ostream& out) {
+    QueryStatus status;
+    if (tokens.getSize() < 6 || tokens.at(1) != "INTO" || tokens.at(3) != "VALUES") {
+        status.ok = false;
+        out << "Error: Invalid INSERT syntax\n";
+        return status;
+    }
+    string tableName = tokens.at(2);
+    if (!db.hasTable(tableName)) {
+        status.ok = false;
+        out << "Error: Table " << tableName << " not found\n";
+        return status;
+    }
+
+    // VALUES (...), (...), ...
+    Array<Array<string>> rows;
+    size_t pos = 4;
+    bool complete = false;
+    while (pos < tokens.getSize() && tokens.at(pos) == "(") {
+        Array<string> values;
+        pos++;
+        while (pos < tokens.getSize() && tokens.at(pos) != ")") {
+            if (tokens.at(pos) != ",") {
+                values.append(stripQuotes(tokens.at(pos)));
+            }
+            pos++;
+        }
+        if (pos >= tokens.getSize()) break;
+        rows.append(std::move(values));
+        pos++;
+        complete = pos == tokens.getSize() || tokens.at(pos) != ",";
+        if (complete) break;
+        pos++;
+    }
+    if (pos + 1 == tokens.getSize() && tokens.at(pos) == ";") pos++;
+    if (!complete || pos != tokens.getSize()) {
+        status.ok = false;
+        out << "Error: Invalid INSERT syntax\n";
+        return status;
+    }
+
+    try {
+        Table& table = db.getTable(tableName);
+        if (rows.getSize() == 1) {
+            table.insert(rows.at(0));
+        } else {
+            table.insertBatch(rows);
+        }
+        db.checkpointIfNeeded();
+        status.rows = rows.getSize();
+        if (rows.getSize() == 1) {
+            out << "Inserted 1 row\n";
+        } else {
+            out << "Inserted " << rows.getSize() << " rows\n";
+        }
+    } catch (const exception& e) {
+        status.ok = false;
+        out << "Error: " << e.what() << "\n";
+    }
+    return status;
+}
+
+QueryStatus executeDelete(const Array<string>& tokens, Database& db, ostream& out) {
+    QueryStatus status;
+    if (tokens.getSize() < 3 || tokens.at(1) != "FROM") {
+        status.ok = false;
+        out << "Error: Invalid DELETE syntax\n";
+        return status;
+    }
+    string tableName = tokens.at(2);
+    if (!db.hasTable(tableName)) {
+        status.ok = false;
+        out << "Error: Table " << tableName << " not found\n";
+        return status;
+    }
+
+    Array<string> whereTokens;
+    if (tokens.getSize() > 3 && tokens.at(3) == "WHERE") {
+        for (size_t i = 4; i < tokens.getSize(); ++i) {
+            whereTokens.append(tokens.at(i));
+        }
+    }
+
+    try {
+        Table& table = db.getTable(tableName);
+        RowLayout layout;
+        layout.addTable(tableName, table.getPkColumnName(), table.getColumns(), table.getColumnTypes());
+        Predicate where = Predicate::compile(whereTokens, layout.getSlots(), layout.getSlotTypes());
+
+        // Conjuncts limiting an indexed column let the table look the rows
+        // up instead of scanning for them; the others still let it pass
+        // over segments whose zone maps rule them out.
+        Array<Predicate> conjuncts = where.splitConjuncts();
+        ColumnRange range;
+        bool indexed = false;
+        {
+            shared_lock<shared_mutex> guard = table.lockForRead();
+            indexed = chooseRange(conjuncts, table, 0, range);
+        }
+
+        status.rows = table.deleteRows([&](const Array<string>& row, const Array<string>&) {
+            return where.evaluate(row);
+        }, indexed ? &range : nullptr, collectBounds(conjuncts, 0));
+        db.checkpointIfNeeded();
+        out << "Deleted rows\n";
+    } catch (const exception& e) {
+        status.ok = false;
+        out << "Error: " << e.what() << "\n";
+    }
+    return status;
+}
+
+QueryStatus executeCreateIndex(const Array<string>& tokens, Database& db, ostream& out) {
+    QueryStatus status;
+    string tableName;
+    IndexDefinition definition;
+    if (!parseIndexStatement(tokens, tableName, definition.column, &definition.ordered)) {
+        status.ok = false;
+        out << "Error: Invalid CREATE INDEX syntax\n";
+        return status;
+    }
+    if (!db.hasTable(tableName)) {
+        status.ok = false;
+        out << "Error: Table " << tableName << " not found\n";
+        return status;
+    }
+    try {
+        db.createIndex(tableName, definition);
+        out << "Index created\n";
+    } catch (const exception& e) {
+        status.ok = false;
+        out << "Error: " << e.what() << "\n";
+    }
+    return status;
+}
+
+QueryStatus executeDropIndex(const Array<string>& tokens, Database& db, ostream& out) {
+    QueryStatus status;
+    string tableName, column;
+    if (!parseIndexStatement(tokens, tableName, column)) {
+        status.ok = false;
+        out << "Error: Invalid DROP INDEX syntax\n";
+        return status;
+    }
+    if (!db.hasTable(tableName)) {
+        status.ok = false;
+        out << "Error: Table " << tableName << " not found\n";
+        return status;
+    }
+    try {
+        db.dropIndex(tableName, column);
+        out << "Index dropped\n";
+    } catch (const exception& e) {
+        status.ok = false;
+        out << "Error: " << e.what() << "\n";
+    }
+    return status;
+}
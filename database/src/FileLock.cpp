@@ -0,0 +1,41 @@
+#include "FileLock.hpp"
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+
+FileLock::FileLock(const filesystem::path& path) : path(path.string()) {
+    fd = open(this->path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw runtime_error("Cannot open lock file " + this->path + ": " + strerror(errno));
+    }
+}
+
+FileLock::~FileLock() {
+    if (fd >= 0) close(fd);
+}
+
+void FileLock::lock() {
+    while (flock(fd, LOCK_EX) < 0) {
+        if (errno != EINTR) {
+            throw runtime_error("Cannot lock " + path + ": " + strerror(errno));
+        }
+    }
+}
+
+bool FileLock::tryLock() {
+    while (flock(fd, LOCK_EX | LOCK_NB) < 0) {
+        if (errno == EWOULDBLOCK) return false;
+        if (errno != EINTR) {
+            throw runtime_error("Cannot lock " + path + ": " + strerror(errno));
+        }
+    }
+    return true;
+}
+
+void FileLock::unlock() {
+    flock(fd, LOCK_UN);
+}
@@ -0,0 +1,67 @@
+#include "MappedFile.hpp"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+
+MappedFile::MappedFile(const filesystem::path& path, Access access) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw runtime_error("Cannot open " + path.string() + ": " + strerror(errno));
+    }
+    try {
+        map(fd, path, access);
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+    close(fd);
+}
+
+MappedFile::MappedFile(int fd, const filesystem::path& path, Access access) {
+    map(fd, path, access);
+}
+
+void MappedFile::map(int fd, const filesystem::path& path, Access access) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        throw runtime_error("Cannot stat " + path.string() + ": " + strerror(errno));
+    }
+    length = static_cast<size_t>(st.st_size);
+    // mmap rejects empty ranges; an empty file is just an empty view.
+    if (length > 0) {
+        void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            throw runtime_error("Cannot map " + path.string() + ": " + strerror(errno));
+        }
+        madvise(p, length, access == Access::Random ? MADV_RANDOM : MADV_SEQUENTIAL);
+        mapping = static_cast<const char*>(p);
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (mapping != nullptr) munmap(const_cast<char*>(mapping), length);
+}
+
+const char* MappedFile::data() const {
+    return mapping;
+}
+
+size_t MappedFile::size() const {
+    return length;
+}
+
+string_view MappedFile::view() const {
+    return string_view(mapping, length);
+}
+
+void prefetchFile(const filesystem::path& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    close(fd);
+}
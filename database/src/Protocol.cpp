@@ -0,0 +1,98 @@
+#include "Protocol.hpp"
+#include <sys/socket.h>
+#include <cerrno>
+#include <stdexcept>
+
+
+namespace {
+
+void putBigEndian(char* out, uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; ++i) {
+        out[i] = static_cast<char>((value >> (8 * (bytes - 1 - i))) & 0xFF);
+    }
+}
+
+uint64_t getBigEndian(const char* in, size_t bytes) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; ++i) {
+        value = (value << 8) | static_cast<unsigned char>(in[i]);
+    }
+    return value;
+}
+
+}
+
+bool sendAll(int socket, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(socket, data, length, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += sent;
+        length -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+void writeHeader(char* header, FrameType type, size_t payloadSize) {
+    putBigEndian(header, payloadSize, 4);
+    header[4] = static_cast<char>(type);
+}
+
+string encodeFrame(FrameType type, const string& payload) {
+    string frame(FRAME_HEADER_SIZE, '\0');
+    writeHeader(&frame[0], type, payload.size());
+    frame += payload;
+    return frame;
+}
+
+string encodeCompletion(const FrameCompletion& completion) {
+    char payload[13];
+    payload[0] = static_cast<char>(completion.status);
+    putBigEndian(payload + 1, completion.rows, 8);
+    putBigEndian(payload + 9, completion.columns, 4);
+    return encodeFrame(FrameType::Complete, string(payload, sizeof(payload)));
+}
+
+bool sendFrame(int socket, FrameType type, const string& payload) {
+    string frame = encodeFrame(type, payload);
+    return sendAll(socket, frame.data(), frame.size());
+}
+
+FrameCompletion parseCompletion(const string& payload) {
+    if (payload.size() < 13) {
+        throw runtime_error("Malformed completion frame");
+    }
+    FrameCompletion completion;
+    completion.status = static_cast<FrameStatus>(payload[0]);
+    completion.rows = getBigEndian(payload.data() + 1, 8);
+    completion.columns = static_cast<uint32_t>(getBigEndian(payload.data() + 9, 4));
+    return completion;
+}
+
+bool takeFrame(string& buffer, Frame& frame) {
+    if (buffer.size() < FRAME_HEADER_SIZE) return false;
+    size_t length = static_cast<size_t>(getBigEndian(buffer.data(), 4));
+    if (length > FRAME_MAX_PAYLOAD) {
+        throw runtime_error("Frame exceeds maximum payload size");
+    }
+    if (buffer.size() < FRAME_HEADER_SIZE + length) return false;
+    frame.type = static_cast<FrameType>(buffer[4]);
+    frame.payload.assign(buffer, FRAME_HEADER_SIZE, length);
+    buffer.erase(0, FRAME_HEADER_SIZE + length);
+    return true;
+}
+
+FrameReader::FrameReader(int socket, string pending) : socket(socket), buffer(std::move(pending)) {}
+
+bool FrameReader::next(Frame& frame) {
+    char chunk[4096];
+    while (!takeFrame(buffer, frame)) {
+        ssize_t received = recv(socket, chunk, sizeof(chunk), 0);
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) return false;
+        buffer.append(chunk, static_cast<size_t>(received));
+    }
+    return true;
+}
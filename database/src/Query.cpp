@@ -0,0 +1,334 @@
+#include "Query.hpp"
+#include "Value.hpp"
+#include <stdexcept>
+
+
+Array<string> tokenize(const string& query) {
+    Array<string> tokens;
+    string current;
+    bool inQuote = false;
+    for (size_t i = 0; i < query.length(); ++i) {
+        char c = query[i];
+        if (inQuote) {
+            if (c == '\'') {
+                inQuote = false;
+                current += c;
+                tokens.append(current);
+                current = "";
+            } else {
+                current += c;
+            }
+        } else {
+            if (isspace(c)) {
+                if (!current.empty()) {
+                    tokens.append(current);
+                    current = "";
+                }
+            } else if (c == ',' || c == '=' || c == '(' || c == ')') {
+                if (!current.empty()) {
+                    tokens.append(current);
+                    current = "";
+                }
+                tokens.append(string(1, c));
+            } else if (c == '<' || c == '>') {
+                if (!current.empty()) {
+                    tokens.append(current);
+                    current = "";
+                }
+                if (i + 1 < query.length() && query[i + 1] == '=') {
+                    tokens.append(string(1, c) + "=");
+                    i++;
+                } else {
+                    tokens.append(string(1, c));
+                }
+            } else if (c == '\'') {
+                if (!current.empty()) {
+                     tokens.append(current);
+                     current = "";
+                }
+                inQuote = true;
+                current += c;
+            } else {
+                current += c;
+            }
+        }
+    }
+    if (!current.empty()) tokens.append(current);
+    return tokens;
+}
+
+bool isComparison(PredicateNode::Kind kind) {
+    return kind != PredicateNode::Kind::And && kind != PredicateNode::Kind::Or;
+}
+
+string stripQuotes(const string& s) {
+    if (s.size() >= 2 && s.front() == '\'' && s.back() == '\'') {
+        return s.substr(1, s.size() - 2);
+    }
+    return s;
+}
+
+Predicate Predicate::compile(const Array<string>& tokens, const ChainingHashTable<string, size_t>& columns,
+                             const Array<ColumnType>& types) {
+    Predicate predicate;
+    if (tokens.empty()) return predicate;
+
+    size_t pos = 0;
+    predicate.root = predicate.parseExpression(tokens, pos, columns, types);
+    if (pos != tokens.getSize()) {
+        throw runtime_error("Invalid WHERE clause near '" + tokens.at(pos) + "'");
+    }
+    return predicate;
+}
+
+bool Predicate::empty() const {
+    return nodes.empty();
+}
+
+bool Predicate::evaluate(const Array<string>& row) const {
+    if (nodes.empty()) return true;
+    return evaluateNode(root, row);
+}
+
+Array<Predicate> Predicate::splitConjuncts() const {
+    Array<Predicate> conjuncts;
+    if (!nodes.empty()) collectConjuncts(root, conjuncts);
+    return conjuncts;
+}
+
+void Predicate::collectConjuncts(size_t index, Array<Predicate>& out) const {
+    const PredicateNode& node = nodes.at(index);
+    if (node.kind == PredicateNode::Kind::And) {
+        collectConjuncts(node.left, out);
+        collectConjuncts(node.right, out);
+        return;
+    }
+    Predicate conjunct;
+    conjunct.root = conjunct.copySubtree(*this, index);
+    out.append(std::move(conjunct));
+}
+
+size_t Predicate::copySubtree(const Predicate& from, size_t index) {
+    PredicateNode node = from.nodes.at(index);
+    if (!isComparison(node.kind)) {
+        node.left = copySubtree(from, node.left);
+        node.right = copySubtree(from, node.right);
+    }
+    return addNode(std::move(node));
+}
+
+bool Predicate::getColumnEquality(size_t& lhsSlot, size_t& rhsSlot) const {
+    if (nodes.empty()) return false;
+    const PredicateNode& node = nodes.at(root);
+    if (node.kind != PredicateNode::Kind::Equals || !node.lhs.isColumn || !node.rhs.isColumn) {
+        return false;
+    }
+    lhsSlot = node.lhs.slot;
+    rhsSlot = node.rhs.slot;
+    return true;
+}
+
+bool Predicate::getConstantEquality(size_t& slot, string& value) const {
+    PredicateNode::Kind kind;
+    return getConstantComparison(slot, kind, value) && kind == PredicateNode::Kind::Equals;
+}
+
+bool Predicate::getConstantComparison(size_t& slot, PredicateNode::Kind& kind, string& value) const {
+    if (nodes.empty()) return false;
+    const PredicateNode& node = nodes.at(root);
+    if (!isComparison(node.kind) || node.lhs.isColumn == node.rhs.isColumn) {
+        return false;
+    }
+    const Operand& column = node.lhs.isColumn ? node.lhs : node.rhs;
+    const Operand& constant = node.lhs.isColumn ? node.rhs : node.lhs;
+    slot = column.slot;
+    value = constant.literal;
+    kind = node.kind;
+    if (!node.lhs.isColumn) {
+        switch (node.kind) {
+            case PredicateNode::Kind::Less: kind = PredicateNode::Kind::Greater; break;
+            case PredicateNode::Kind::LessEqual: kind = PredicateNode::Kind::GreaterEqual; break;
+            case PredicateNode::Kind::Greater: kind = PredicateNode::Kind::Less; break;
+            case PredicateNode::Kind::GreaterEqual: kind = PredicateNode::Kind::LessEqual; break;
+            default: break;
+        }
+    }
+    return true;
+}
+
+void Predicate::collectSlots(Array<size_t>& slots) const {
+    for (size_t i = 0; i < nodes.getSize(); ++i) {
+        const PredicateNode& node = nodes.at(i);
+        if (!isComparison(node.kind)) continue;
+        if (node.lhs.isColumn) slots.append(node.lhs.slot);
+        if (node.rhs.isColumn) slots.append(node.rhs.slot);
+    }
+}
+
+size_t Predicate::addNode(PredicateNode node) {
+    nodes.append(std::move(node));
+    return nodes.getSize() - 1;
+}
+
+Operand Predicate::resolveOperand(const string& token, const ChainingHashTable<string, size_t>& columns) {
+    Operand operand;
+    if (token.size() >= 2 && token.front() == '\'' && token.back() == '\'') {
+        operand.literal = stripQuotes(token);
+    } else if (columns.find(token)) {
+        operand.isColumn = true;
+        operand.slot = columns.at(token);
+    } else {
+        operand.literal = token;
+    }
+    return operand;
+}
+
+// operand op operand, or operand BETWEEN low AND high, which becomes
+// operand >= low AND operand <= high.
+size_t Predicate::parseCondition(const Array<string>& tokens, size_t& pos, const ChainingHashTable<string, size_t>& columns,
+                                 const Array<ColumnType>& types) {
+    if (pos + 2 >= tokens.getSize()) {
+        throw runtime_error("Invalid WHERE clause: incomplete condition");
+    }
+    const string& op = tokens.at(pos + 1);
+    if (op == "BETWEEN") {
+        if (pos + 4 >= tokens.getSize() || tokens.at(pos + 3) != "AND") {
+            throw runtime_error("Invalid WHERE clause: BETWEEN needs low AND high");
+        }
+        PredicateNode node;
+        node.kind = PredicateNode::Kind::And;
+        node.left = addComparison(PredicateNode::Kind::GreaterEqual, tokens.at(pos), tokens.at(pos + 2), columns, types);
+        node.right = addComparison(PredicateNode::Kind::LessEqual, tokens.at(pos), tokens.at(pos + 4), columns, types);
+        pos += 5;
+        return addNode(std::move(node));
+    }
+
+    PredicateNode::Kind kind;
+    if (op == "=") {
+        kind = PredicateNode::Kind::Equals;
+    } else if (op == "<") {
+        kind = PredicateNode::Kind::Less;
+    } else if (op == "<=") {
+        kind = PredicateNode::Kind::LessEqual;
+    } else if (op == ">") {
+        kind = PredicateNode::Kind::Greater;
+    } else if (op == ">=") {
+        kind = PredicateNode::Kind::GreaterEqual;
+    } else {
+        throw runtime_error("Invalid WHERE clause near '" + op + "'");
+    }
+    size_t index = addComparison(kind, tokens.at(pos), tokens.at(pos + 2), columns, types);
+    pos += 3;
+    return index;
+}
+
+// A comparison takes the type of the column it reads and the constant on
+// the other side is put in that type's canonical form. Two columns compare
+// as their common type, as double when they are int64 and double.
+size_t Predicate::addComparison(PredicateNode::Kind kind, const string& lhs, const string& rhs,
+                                const ChainingHashTable<string, size_t>& columns, const Array<ColumnType>& types) {
+    PredicateNode node;
+    node.kind = kind;
+    node.lhs = resolveOperand(lhs, columns);
+    node.rhs = resolveOperand(rhs, columns);
+    auto slotType = [&types](const Operand& operand) {
+        if (!operand.isColumn || operand.slot >= types.getSize()) return ColumnType::Untyped;
+        return types.at(operand.slot);
+    };
+    ColumnType lhsType = slotType(node.lhs);
+    ColumnType rhsType = slotType(node.rhs);
+    if (node.lhs.isColumn && node.rhs.isColumn) {
+        auto numeric = [](ColumnType type) { return type == ColumnType::Int64 || type == ColumnType::Double; };
+        if (lhsType == rhsType) {
+            node.type = lhsType;
+        } else if (numeric(lhsType) && numeric(rhsType)) {
+            node.type = ColumnType::Double;
+        }
+        return addNode(std::move(node));
+    }
+    node.type = node.lhs.isColumn ? lhsType : rhsType;
+    Operand& constant = node.lhs.isColumn ? node.rhs : node.lhs;
+    string canonical;
+    if (!canonicalValue(node.type, constant.literal, canonical)) {
+        throw runtime_error("Invalid " + string(columnTypeName(node.type)) + " value '" + constant.literal +
+                            "' in WHERE clause");
+    }
+    constant.literal = std::move(canonical);
+    return addNode(std::move(node));
+}
+
+size_t Predicate::parseFactor(const Array<string>& tokens, size_t& pos, const ChainingHashTable<string, size_t>& columns,
+                              const Array<ColumnType>& types) {
+    if (pos >= tokens.getSize()) {
+        throw runtime_error("Invalid WHERE clause: unexpected end");
+    }
+    if (tokens.at(pos) == "(") {
+        pos++;
+        size_t inner = parseExpression(tokens, pos, columns, types);
+        if (pos >= tokens.getSize() || tokens.at(pos) != ")") {
+            throw runtime_error("Invalid WHERE clause: missing ')'");
+        }
+        pos++;
+        return inner;
+    }
+    return parseCondition(tokens, pos, columns, types);
+}
+
+size_t Predicate::parseTerm(const Array<string>& tokens, size_t& pos, const ChainingHashTable<string, size_t>& columns,
+                            const Array<ColumnType>& types) {
+    size_t left = parseFactor(tokens, pos, columns, types);
+    while (pos < tokens.getSize() && tokens.at(pos) == "AND") {
+        pos++;
+        PredicateNode node;
+        node.kind = PredicateNode::Kind::And;
+        node.left = left;
+        node.right = parseFactor(tokens, pos, columns, types);
+        left = addNode(std::move(node));
+    }
+    return left;
+}
+
+size_t Predicate::parseExpression(const Array<string>& tokens, size_t& pos, const ChainingHashTable<string, size_t>& columns,
+                                  const Array<ColumnType>& types) {
+    size_t left = parseTerm(tokens, pos, columns, types);
+    while (pos < tokens.getSize() && tokens.at(pos) == "OR") {
+        pos++;
+        PredicateNode node;
+        node.kind = PredicateNode::Kind::Or;
+        node.left = left;
+        node.right = parseTerm(tokens, pos, columns, types);
+        left = addNode(std::move(node));
+    }
+    return left;
+}
+
+const string& Predicate::operandValue(const Operand& operand, const Array<string>& row) {
+    static const string emptyCell;
+    if (!operand.isColumn) return operand.literal;
+    if (operand.slot >= row.getSize()) return emptyCell;
+    return row.at(operand.slot);
+}
+
+bool Predicate::evaluateNode(size_t index, const Array<string>& row) const {
+    const PredicateNode& node = nodes.at(index);
+    switch (node.kind) {
+        case PredicateNode::Kind::And:
+            return evaluateNode(node.left, row) && evaluateNode(node.right, row);
+        case PredicateNode::Kind::Or:
+            return evaluateNode(node.left, row) || evaluateNode(node.right, row);
+        case PredicateNode::Kind::Equals:
+            return operandValue(node.lhs, row) == operandValue(node.rhs, row);
+        default:
+            break;
+    }
+    const string& lhs = operandValue(node.lhs, row);
+    const string& rhs = operandValue(node.rhs, row);
+    if (lhs.empty() || rhs.empty()) return false;
+    int order = compareCells(node.type, lhs, rhs);
+    switch (node.kind) {
+        case PredicateNode::Kind::Less: return order < 0;
+        case PredicateNode::Kind::LessEqual: return order <= 0;
+        case PredicateNode::Kind::Greater: return order > 0;
+        default: return order >= 0;
+    }
+}
@@ -0,0 +1,362 @@
+#include "Reactor.hpp"
+#include "Protocol.hpp"
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+
+namespace {
+
+void setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        throw runtime_error(string("fcntl: ") + strerror(errno));
+    }
+}
+
+}
+
+Connection::Connection(int fd, size_t outputHighWater, chrono::seconds writeTimeout)
+    : fd(fd), outputHighWater(outputHighWater), writeTimeout(writeTimeout) {}
+
+int Connection::getFd() const {
+    return fd;
+}
+
+bool Connection::isFramed() const {
+    return framed;
+}
+
+bool Connection::write(string chunk) {
+    if (chunk.empty()) return true;
+    bool room;
+    {
+        unique_lock<mutex> lock(mtx);
+        room = drained.wait_for(lock, writeTimeout, [this] { return closed || outputBytes < outputHighWater; });
+        if (closed) return false;
+        if (room) {
+            outputBytes += chunk.size();
+            output.push(std::move(chunk));
+        } else {
+            stalled = true;
+        }
+    }
+    onOutput();
+    return room;
+}
+
+void Connection::requestClose() {
+    {
+        lock_guard<mutex> lock(mtx);
+        closing = true;
+    }
+    onOutput();
+}
+
+Reactor::Reactor(const ReactorConfig& config, RequestHandler handler)
+    : config(config), handler(std::move(handler)), pool(config.workers, config.queueDepth) {
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        throw runtime_error("Ошибка создания сокета");
+    }
+
+    int opt = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    sockaddr_in serverAddr{};
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_addr.s_addr = INADDR_ANY;
+    serverAddr.sin_port = htons(config.port);
+
+    if (bind(listenFd, (sockaddr*)&serverAddr, sizeof(serverAddr)) < 0) {
+        close(listenFd);
+        throw runtime_error("не удалось подключиться к " + to_string(config.port) + " порту");
+    }
+    if (listen(listenFd, config.backlog) < 0) {
+        close(listenFd);
+        throw runtime_error("не прослушивается");
+    }
+    setNonBlocking(listenFd);
+
+    epollFd = epoll_create1(0);
+    wakeFd = eventfd(0, EFD_NONBLOCK);
+    if (epollFd < 0 || wakeFd < 0) {
+        throw runtime_error(string("epoll: ") + strerror(errno));
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = listenFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event);
+    event.data.fd = wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+}
+
+Reactor::~Reactor() {
+    Array<int> fds = connections.getAllKeys();
+    for (size_t i = 0; i < fds.getSize(); ++i) {
+        shared_ptr<Connection> connection = connections.at(fds.at(i));
+        closeConnection(connection);
+    }
+    if (wakeFd >= 0) close(wakeFd);
+    if (epollFd >= 0) close(epollFd);
+    if (listenFd >= 0) close(listenFd);
+}
+
+void Reactor::run() {
+    const int maxEvents = 64;
+    epoll_event events[maxEvents];
+    while (true) {
+        int count = epoll_wait(epollFd, events, maxEvents, -1);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            throw runtime_error(string("epoll_wait: ") + strerror(errno));
+        }
+        for (int i = 0; i < count; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == listenFd) {
+                acceptConnections();
+                continue;
+            }
+            if (fd == wakeFd) {
+                processWakeups();
+                continue;
+            }
+            shared_ptr<Connection>* found = connections.getPointer(fd);
+            if (found == nullptr) continue;
+            shared_ptr<Connection> connection = *found;
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                closeConnection(connection);
+                continue;
+            }
+            if (events[i].events & EPOLLIN) readFrom(connection);
+            if (events[i].events & EPOLLOUT) flushOutput(connection);
+        }
+    }
+}
+
+void Reactor::acceptConnections() {
+    while (true) {
+        int clientFd = accept(listenFd, nullptr, nullptr);
+        if (clientFd < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        if (connections.size() >= config.maxConnections) {
+            const char message[] = "Error: too many connections\n";
+            send(clientFd, message, sizeof(message) - 1, MSG_NOSIGNAL | MSG_DONTWAIT);
+            close(clientFd);
+            continue;
+        }
+        setNonBlocking(clientFd);
+
+        auto connection = make_shared<Connection>(clientFd, config.outputHighWater,
+                                                  chrono::seconds(config.writeTimeoutSeconds));
+        weak_ptr<Connection> weak = connection;
+        connection->onOutput = [this, weak]() {
+            if (auto self = weak.lock()) wake(self);
+        };
+        connections.insert(clientFd, connection);
+
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = clientFd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, clientFd, &event);
+    }
+}
+
+void Reactor::readFrom(const shared_ptr<Connection>& connection) {
+    char buffer[16384];
+    ssize_t received = recv(connection->fd, buffer, sizeof(buffer), 0);
+    if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) return;
+    if (received <= 0) {
+        closeConnection(connection);
+        return;
+    }
+    connection->input.append(buffer, static_cast<size_t>(received));
+
+    try {
+        parseRequests(*connection);
+    } catch (const exception& e) {
+        cerr << "Ошибка: " << e.what() << "\n";
+        closeConnection(connection);
+        return;
+    }
+    dispatch(connection);
+    updateInterest(*connection);
+}
+
+void Reactor::parseRequests(Connection& connection) {
+    if (!connection.handshakeChecked) {
+        string handshake(FRAME_HANDSHAKE, FRAME_HANDSHAKE_SIZE);
+        size_t prefix = min(connection.input.size(), FRAME_HANDSHAKE_SIZE);
+        if (connection.input.compare(0, prefix, handshake, 0, prefix) == 0) {
+            if (connection.input.size() < FRAME_HANDSHAKE_SIZE) return;
+            connection.framed = true;
+            connection.input.erase(0, FRAME_HANDSHAKE_SIZE);
+            lock_guard<mutex> lock(connection.mtx);
+            connection.outputBytes += handshake.size();
+            connection.output.push(handshake);
+        }
+        connection.handshakeChecked = true;
+    }
+
+    if (connection.framed) {
+        Frame frame;
+        while (takeFrame(connection.input, frame)) {
+            if (frame.type != FrameType::Query) {
+                throw runtime_error("Unexpected frame from client");
+            }
+            connection.requests.push(std::move(frame.payload));
+        }
+        return;
+    }
+
+    // Text mode: every read is one whole query, newlines and all, as legacy
+    // clients send one statement and wait for its output before the next.
+    connection.requests.push(std::move(connection.input));
+    connection.input.clear();
+}
+
+void Reactor::dispatch(const shared_ptr<Connection>& connection) {
+    if (connection->closed || connection->requests.empty()) return;
+    {
+        lock_guard<mutex> lock(connection->mtx);
+        if (connection->busy || connection->closing) return;
+        connection->busy = true;
+    }
+
+    string query = connection->requests.front();
+    bool posted = pool.tryPost([this, connection, query]() {
+        handler(*connection, query);
+        {
+            lock_guard<mutex> lock(connection->mtx);
+            connection->busy = false;
+        }
+        wake(connection);
+    });
+
+    if (posted) {
+        connection->requests.pop();
+        return;
+    }
+    {
+        lock_guard<mutex> lock(connection->mtx);
+        connection->busy = false;
+    }
+    if (!connection->waitingForWorker) {
+        connection->waitingForWorker = true;
+        waiting.push(connection);
+    }
+}
+
+void Reactor::retryWaiting() {
+    size_t count = waiting.getSize();
+    for (size_t i = 0; i < count; ++i) {
+        shared_ptr<Connection> connection = waiting.pop();
+        connection->waitingForWorker = false;
+        dispatch(connection);
+        updateInterest(*connection);
+        if (connection->waitingForWorker) break;
+    }
+}
+
+void Reactor::flushOutput(const shared_ptr<Connection>& connection) {
+    if (connection->closed) return;
+    bool failed = false;
+    bool finished = false;
+    {
+        lock_guard<mutex> lock(connection->mtx);
+        while (!connection->output.empty()) {
+            string& chunk = connection->output.front();
+            ssize_t sent = send(connection->fd, chunk.data() + connection->outputOffset,
+                                chunk.size() - connection->outputOffset, MSG_NOSIGNAL);
+            if (sent < 0) {
+                if (errno == EINTR) continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK) failed = true;
+                break;
+            }
+            connection->outputOffset += static_cast<size_t>(sent);
+            connection->outputBytes -= static_cast<size_t>(sent);
+            if (connection->outputOffset == chunk.size()) {
+                connection->output.pop();
+                connection->outputOffset = 0;
+            }
+        }
+        finished = connection->closing && !connection->busy && connection->output.empty();
+        failed = failed || connection->stalled;
+    }
+    connection->drained.notify_all();
+
+    if (failed || finished) {
+        closeConnection(connection);
+        return;
+    }
+    updateInterest(*connection);
+}
+
+void Reactor::processWakeups() {
+    uint64_t counter;
+    while (read(wakeFd, &counter, sizeof(counter)) > 0) {}
+
+    Queue<shared_ptr<Connection>> ready;
+    {
+        lock_guard<mutex> lock(wakeMutex);
+        while (!wakeups.empty()) ready.push(wakeups.pop());
+    }
+    while (!ready.empty()) {
+        shared_ptr<Connection> connection = ready.pop();
+        if (connection->closed) continue;
+        flushOutput(connection);
+        dispatch(connection);
+        if (!connection->closed) updateInterest(*connection);
+    }
+    retryWaiting();
+}
+
+void Reactor::updateInterest(Connection& connection) {
+    if (connection.closed) return;
+    bool pendingOutput;
+    {
+        lock_guard<mutex> lock(connection.mtx);
+        pendingOutput = !connection.output.empty();
+    }
+    bool pauseRead = connection.requests.getSize() >= config.maxPendingRequests;
+    if (pendingOutput == connection.writeArmed && pauseRead == connection.readPaused) return;
+
+    connection.writeArmed = pendingOutput;
+    connection.readPaused = pauseRead;
+    epoll_event event{};
+    event.events = (pauseRead ? 0u : static_cast<uint32_t>(EPOLLIN)) | (pendingOutput ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+    event.data.fd = connection.fd;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+}
+
+void Reactor::closeConnection(const shared_ptr<Connection>& connection) {
+    {
+        lock_guard<mutex> lock(connection->mtx);
+        if (connection->closed) return;
+        connection->closed = true;
+    }
+    connection->drained.notify_all();
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, connection->fd, nullptr);
+    connections.remove(connection->fd);
+    close(connection->fd);
+}
+
+void Reactor::wake(const shared_ptr<Connection>& connection) {
+    {
+        lock_guard<mutex> lock(wakeMutex);
+        wakeups.push(connection);
+    }
+    uint64_t one = 1;
+    ssize_t ignored = ::write(wakeFd, &one, sizeof(one));
+    (void)ignored;
+}
@@ -0,0 +1,66 @@
+#include "Row.hpp"
+
+
+size_t RowLayout::addTable(const string& name, const string& pkName, const Array<string>& columns,
+                           const Array<ColumnType>& types) {
+    size_t offset = width;
+    for (size_t i = 0; i <= columns.getSize(); ++i) {
+        slotTypes.append(i < types.getSize() ? types.at(i) : ColumnType::Untyped);
+    }
+    slots.insert(pkName, offset);
+    slots.insert(name + "." + pkName, offset);
+    for (size_t i = 0; i < columns.getSize(); ++i) {
+        slots.insert(name + "." + columns.at(i), offset + i + 1);
+        slots.insert(columns.at(i), offset + i + 1);
+    }
+    offsets.append(offset);
+    widths.append(columns.getSize() + 1);
+    width += columns.getSize() + 1;
+    return offsets.getSize() - 1;
+}
+
+bool RowLayout::resolve(const string& name, size_t& slot) const {
+    const size_t* found = slots.getPointer(name);
+    if (found == nullptr) return false;
+    slot = *found;
+    return true;
+}
+
+const ChainingHashTable<string, size_t>& RowLayout::getSlots() const {
+    return slots;
+}
+
+const Array<ColumnType>& RowLayout::getSlotTypes() const {
+    return slotTypes;
+}
+
+size_t RowLayout::getWidth() const {
+    return width;
+}
+
+size_t RowLayout::getTableCount() const {
+    return offsets.getSize();
+}
+
+size_t RowLayout::getTableOffset(size_t table) const {
+    return offsets.at(table);
+}
+
+size_t RowLayout::getTableWidth(size_t table) const {
+    return widths.at(table);
+}
+
+size_t RowLayout::getTableOfSlot(size_t slot) const {
+    for (size_t t = offsets.getSize(); t > 0; --t) {
+        if (slot >= offsets.at(t - 1)) return t - 1;
+    }
+    throw out_of_range("Slot outside of row layout");
+}
+
+Array<string> RowLayout::makeRow() const {
+    Array<string> row;
+    for (size_t i = 0; i < width; ++i) {
+        row.append(string());
+    }
+    return row;
+}
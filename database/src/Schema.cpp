@@ -12,6 +12,18 @@ Schema Schema::loadFromFile(const filesystem::path& path) {
     Schema s;
     s.name = j.at("name").get<string>();
     s.tuplesLimit = j.at("tuples_limit").get<size_t>();
+    if (j.contains("wal_sync")) {
+        s.walSync = j.at("wal_sync").get<string>();
+    }
+    if (j.contains("wal_sync_interval_ms")) {
+        s.walSyncIntervalMs = j.at("wal_sync_interval_ms").get<size_t>();
+    }
+    if (j.contains("storage")) {
+        s.storage = j.at("storage").get<string>();
+        if (s.storage != "csv" && s.storage != "columnar") {
+            throw runtime_error("Unknown storage: " + s.storage);
+        }
+    }
     json structure_json = j.at("structure");
     if (!structure_json.is_object()) {
         throw runtime_error("Structure in schema must be an object");
@@ -19,12 +31,54 @@ Schema Schema::loadFromFile(const filesystem::path& path) {
     
     for (auto& [table_name, table_schema] : structure_json.items()) {
         Array<string> columns;
+        Array<ColumnType> types;
         if (table_schema.is_array()) {
             for (const auto& col : table_schema) {
-                columns.append(col.get<string>());
+                if (!col.is_object()) {
+                    columns.append(col.get<string>());
+                    types.append(ColumnType::Untyped);
+                    continue;
+                }
+                ColumnType type = ColumnType::Untyped;
+                if (col.contains("type")) {
+                    string typeName = col.at("type").get<string>();
+                    if (!parseColumnType(typeName, type)) {
+                        throw runtime_error("Unknown column type: " + typeName);
+                    }
+                }
+                columns.append(col.at("name").get<string>());
+                types.append(type);
             }
         }
         s.structure.insert(table_name, columns);
+        s.columnTypes.insert(table_name, types);
+    }
+    if (j.contains("bloom_false_positive_rate")) {
+        s.bloomFalsePositiveRate = j.at("bloom_false_positive_rate").get<double>();
+        if (!(s.bloomFalsePositiveRate > 0 && s.bloomFalsePositiveRate < 1)) {
+            throw runtime_error("bloom_false_positive_rate must be between 0 and 1");
+        }
+    }
+    if (j.contains("bloom_filters")) {
+        for (auto& [table_name, bloom_columns] : j.at("bloom_filters").items()) {
+            const Array<string>* columns = s.structure.getPointer(table_name);
+            if (columns == nullptr) {
+                throw runtime_error("Unknown table in bloom_filters: " + table_name);
+            }
+            Array<string> names;
+            for (const auto& col : bloom_columns) {
+                string name = col.get<string>();
+                bool known = false;
+                for (size_t i = 0; i < columns->getSize(); ++i) {
+                    if (columns->at(i) == name) known = true;
+                }
+                if (!known) {
+                    throw runtime_error("Unknown column in bloom_filters: " + table_name + "." + name);
+                }
+                names.append(name);
+            }
+            s.bloomFilters.insert(table_name, names);
+        }
     }
     return s;
 }
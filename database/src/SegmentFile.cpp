@@ -0,0 +1,318 @@
+#include "SegmentFile.hpp"
+#include "Csv.hpp"
+#include "Value.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+
+namespace {
+
+const char FOOTER_MAGIC[] = "DBCOLEN2";
+const char TEXT_FOOTER_MAGIC[] = "DBCOLEND";
+const size_t FOOTER_SIZE = 8 + 4 + 8;
+const size_t DIRECTORY_ENTRY_SIZE = 24;
+const size_t TEXT_DIRECTORY_ENTRY_SIZE = 16;
+
+void putInt(string& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        out += static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+}
+
+uint64_t getInt(const char* data, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i) {
+        value |= static_cast<uint64_t>(static_cast<unsigned char>(data[i])) << (8 * i);
+    }
+    return value;
+}
+
+struct Footer {
+    size_t rows;
+    // Start of the block directory, and the size of its entries.
+    const char* directory;
+    size_t entrySize;
+};
+
+Footer readFooter(const MappedFile& file, size_t width, const filesystem::path& path) {
+    if (file.size() < FOOTER_SIZE) {
+        throw runtime_error("Corrupt columnar segment " + path.string());
+    }
+    Footer result;
+    const char* magic = file.data() + file.size() - 8;
+    if (memcmp(magic, FOOTER_MAGIC, 8) == 0) {
+        result.entrySize = DIRECTORY_ENTRY_SIZE;
+    } else if (memcmp(magic, TEXT_FOOTER_MAGIC, 8) == 0) {
+        result.entrySize = TEXT_DIRECTORY_ENTRY_SIZE;
+    } else {
+        throw runtime_error("Corrupt columnar segment " + path.string());
+    }
+    const char* footer = file.data() + file.size() - FOOTER_SIZE;
+    result.rows = getInt(footer, 8);
+    if (getInt(footer + 8, 4) != width) {
+        throw runtime_error("Column count mismatch in " + path.string());
+    }
+    if (file.size() - FOOTER_SIZE < width * result.entrySize) {
+        throw runtime_error("Corrupt columnar segment " + path.string());
+    }
+    result.directory = footer - width * result.entrySize;
+    return result;
+}
+}
+
+void ZoneMap::addRow(const Array<string>& cells, size_t offset) {
+    size_t width = types.getSize();
+    if (rows == 0) {
+        min = Array<string>();
+        max = Array<string>();
+        nulls = Array<size_t>();
+        for (size_t c = 0; c < width; ++c) {
+            min.append(string());
+            max.append(string());
+            nulls.append(0);
+        }
+    }
+    for (size_t c = 0; c < width; ++c) {
+        const string& value = cells.at(offset + c);
+        if (value.empty()) {
+            nulls.at(c)++;
+        } else if (rows == nulls.at(c)) {
+            min.at(c) = value;
+            max.at(c) = value;
+        } else if (compareCells(types.at(c), value, min.at(c)) < 0) {
+            min.at(c) = value;
+        } else if (compareCells(types.at(c), value, max.at(c)) > 0) {
+            max.at(c) = value;
+        }
+    }
+    rows++;
+}
+
+SegmentHandle::SegmentHandle(filesystem::path path) : path(std::move(path)) {}
+
+SegmentHandle::~SegmentHandle() {
+    if (fd >= 0) close(fd);
+}
+
+void SegmentHandle::pin() {
+    lock_guard<mutex> guard(lock);
+    if (fd < 0) fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+}
+
+shared_ptr<const MappedFile> SegmentHandle::map(MappedFile::Access access) const {
+    lock_guard<mutex> guard(lock);
+    if (fd >= 0) return make_shared<const MappedFile>(fd, path, access);
+    return make_shared<const MappedFile>(path, access);
+}
+
+bool isColumnar(const filesystem::path& file) {
+    return file.extension() == COLUMNAR_EXTENSION;
+}
+
+size_t countRows(const filesystem::path& file) {
+    MappedFile mapped(file);
+    if (isColumnar(file)) {
+        if (mapped.size() < FOOTER_SIZE) {
+            throw runtime_error("Corrupt columnar segment " + file.string());
+        }
+        return getInt(mapped.data() + mapped.size() - FOOTER_SIZE, 8);
+    }
+
+    // CSV: the records minus the header.
+    CsvCursor cursor(mapped.view());
+    size_t records = 0;
+    while (cursor.skip()) records++;
+    return records > 0 ? records - 1 : 0;
+}
+
+size_t writeColumnar(const filesystem::path& csvFile, const filesystem::path& target,
+                     const Array<ColumnType>& types) {
+    size_t width = types.getSize();
+    Array<Array<uint32_t>> offsets;
+    Array<string> data;
+    // Binary forms of the typed columns, until a cell turns up without one.
+    Array<string> binary;
+    Array<bool> binaryValid;
+    for (size_t c = 0; c < width; ++c) {
+        Array<uint32_t> columnOffsets;
+        columnOffsets.append(0);
+        offsets.append(std::move(columnOffsets));
+        data.append(string());
+        binary.append(string());
+        binaryValid.append(binaryWidth(types.at(c)) > 0);
+    }
+
+    MappedFile in(csvFile);
+    CsvCursor cursor(in.view());
+    Array<string> row;
+    for (size_t c = 0; c < width; ++c) {
+        row.append(string());
+    }
+    cursor.skip();
+    size_t rows = 0;
+    while (cursor.next(row, 0, width)) {
+        for (size_t c = 0; c < width; ++c) {
+            data.at(c) += row.at(c);
+            if (data.at(c).size() > UINT32_MAX) {
+                throw runtime_error("Cannot write " + target.string() + ": column " + to_string(c) +
+                                    " holds more than 4 GB");
+            }
+            offsets.at(c).append(static_cast<uint32_t>(data.at(c).size()));
+            if (binaryValid.at(c) && !encodeBinary(types.at(c), row.at(c), binary.at(c))) {
+                binaryValid.at(c) = false;
+                binary.at(c) = string();
+            }
+        }
+        rows++;
+    }
+
+    string file;
+    string directory;
+    for (size_t c = 0; c < width; ++c) {
+        size_t start = file.size();
+        ColumnType encoding = ColumnType::Untyped;
+        if (binaryValid.at(c)) {
+            encoding = types.at(c);
+            file += binary.at(c);
+        } else {
+            for (size_t r = 0; r < offsets.at(c).getSize(); ++r) {
+                putInt(file, offsets.at(c).at(r), 4);
+            }
+            file += data.at(c);
+        }
+        putInt(directory, start, 8);
+        putInt(directory, file.size() - start, 8);
+        putInt(directory, static_cast<uint64_t>(encoding), 8);
+    }
+    file += directory;
+    putInt(file, rows, 8);
+    putInt(file, width, 4);
+    file.append(FOOTER_MAGIC, 8);
+
+    int fd = open(target.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw runtime_error("Cannot write " + target.string() + ": " + strerror(errno));
+    }
+    size_t written = 0;
+    bool ok = true;
+    while (ok && written < file.size()) {
+        ssize_t n = ::write(fd, file.data() + written, file.size() - written);
+        if (n < 0 && errno == EINTR) continue;
+        ok = n > 0;
+        if (ok) written += static_cast<size_t>(n);
+    }
+    ok = ok && fsync(fd) == 0;
+    close(fd);
+    if (!ok) {
+        throw runtime_error("Cannot write " + target.string() + ": " + strerror(errno));
+    }
+    return rows;
+}
+
+SegmentReader::SegmentReader(const Segment& segment, size_t width, const Array<bool>* columns,
+                             shared_ptr<const MappedFile> mapped)
+    : segment(segment), width(width), columnar(isColumnar(segment.file)),
+      file(mapped ? std::move(mapped) : make_shared<const MappedFile>(segment.file)) {
+    if (!columnar) {
+        csv = CsvCursor(file->view());
+        csv.skip();
+        return;
+    }
+
+    Footer footer = readFooter(*file, width, segment.file);
+    rowCount = footer.rows;
+    for (size_t c = 0; c < width; ++c) {
+        const char* entry = footer.directory + c * footer.entrySize;
+        uint64_t offset = getInt(entry, 8);
+        uint64_t length = getInt(entry + 8, 8);
+        ColumnType encoding = ColumnType::Untyped;
+        if (footer.entrySize == DIRECTORY_ENTRY_SIZE) {
+            uint64_t code = getInt(entry + 16, 8);
+            if (code > static_cast<uint64_t>(ColumnType::Timestamp)) {
+                throw runtime_error("Corrupt columnar segment " + segment.file.string());
+            }
+            encoding = static_cast<ColumnType>(code);
+        }
+        size_t cellWidth = binaryWidth(encoding);
+        size_t minimum = cellWidth > 0 ? rowCount * cellWidth : (rowCount + 1) * 4;
+        if (offset + length > file->size() || length < minimum) {
+            throw runtime_error("Corrupt columnar segment " + segment.file.string());
+        }
+        bool wanted = columns == nullptr || columns->at(c);
+        const char* block = file->data() + offset;
+        offsets.append(wanted && cellWidth == 0 ? block : nullptr);
+        cells.append(wanted ? (cellWidth > 0 ? block : block + (rowCount + 1) * 4) : nullptr);
+        cellBytes.append(cellWidth > 0 ? 0 : length - (rowCount + 1) * 4);
+        encodings.append(encoding);
+    }
+}
+
+void SegmentReader::readCell(size_t column, size_t row, string& out) const {
+    size_t cellWidth = binaryWidth(encodings.at(column));
+    if (cellWidth > 0) {
+        decodeBinary(encodings.at(column), cells.at(column) + row * cellWidth, out);
+        return;
+    }
+    uint32_t begin = static_cast<uint32_t>(getInt(offsets.at(column) + row * 4, 4));
+    uint32_t end = static_cast<uint32_t>(getInt(offsets.at(column) + (row + 1) * 4, 4));
+    if (begin > end || end > cellBytes.at(column)) {
+        throw runtime_error("Corrupt columnar segment " + segment.file.string());
+    }
+    out.assign(cells.at(column) + begin, end - begin);
+}
+
+bool SegmentReader::next(Array<string>& row, size_t offset) {
+    if (!columnar) {
+        while (true) {
+            const char* start = csv.position();
+            if (!csv.next(row, offset, width)) return false;
+            size_t current = position++;
+            if (segment.deleted.test(current)) continue;
+            ordinal = current;
+            rowOffset = static_cast<size_t>(start - file->data());
+            return true;
+        }
+    }
+
+    while (position < rowCount) {
+        size_t current = position++;
+        if (segment.deleted.test(current)) continue;
+        ordinal = current;
+        for (size_t c = 0; c < width; ++c) {
+            if (cells.at(c) == nullptr) continue;
+            readCell(c, current, row.at(offset + c));
+        }
+        return true;
+    }
+    return false;
+}
+
+size_t SegmentReader::getOrdinal() const {
+    return ordinal;
+}
+
+size_t SegmentReader::getOffset() const {
+    return rowOffset;
+}
+
+bool SegmentReader::readAt(const RowLocation& location, Array<string>& row, size_t offset) {
+    if (segment.deleted.test(location.ordinal)) return false;
+    if (!columnar) {
+        if (location.offset >= file->size()) return false;
+        CsvCursor cursor(string_view(file->data() + location.offset, file->size() - location.offset));
+        if (!cursor.next(row, offset, width)) return false;
+    } else {
+        if (location.ordinal >= rowCount) return false;
+        for (size_t c = 0; c < width; ++c) {
+            if (cells.at(c) == nullptr) continue;
+            readCell(c, location.ordinal, row.at(offset + c));
+        }
+    }
+    ordinal = location.ordinal;
+    rowOffset = location.offset;
+    return true;
+}
@@ -0,0 +1,61 @@
+#include "SocketStream.hpp"
+#include "Protocol.hpp"
+#include <cstring>
+
+
+SocketStreamBuf::SocketStreamBuf(Connection& connection, size_t chunkSize)
+    : connection(connection), buffer(new char[chunkSize]), chunkSize(chunkSize) {
+    setp(buffer, buffer + chunkSize);
+}
+
+SocketStreamBuf::~SocketStreamBuf() {
+    flushBuffer();
+    delete[] buffer;
+}
+
+bool SocketStreamBuf::sendChunk(const char* data, size_t length) {
+    if (failed) return false;
+    string chunk(data, length);
+    if (connection.isFramed()) {
+        chunk = encodeFrame(FrameType::Data, chunk);
+    }
+    failed = !connection.write(std::move(chunk));
+    return !failed;
+}
+
+bool SocketStreamBuf::flushBuffer() {
+    size_t pending = static_cast<size_t>(pptr() - pbase());
+    bool ok = pending == 0 || sendChunk(pbase(), pending);
+    setp(buffer, buffer + chunkSize);
+    return ok;
+}
+
+int SocketStreamBuf::overflow(int c) {
+    if (!flushBuffer()) return traits_type::eof();
+    if (c != traits_type::eof()) {
+        *pptr() = static_cast<char>(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+streamsize SocketStreamBuf::xsputn(const char* s, streamsize n) {
+    size_t length = static_cast<size_t>(n);
+    size_t room = static_cast<size_t>(epptr() - pptr());
+    if (length <= room) {
+        memcpy(pptr(), s, length);
+        pbump(static_cast<int>(length));
+        return n;
+    }
+    if (!flushBuffer()) return 0;
+    if (length >= chunkSize) {
+        return sendChunk(s, length) ? n : 0;
+    }
+    memcpy(pptr(), s, length);
+    pbump(static_cast<int>(length));
+    return n;
+}
+
+int SocketStreamBuf::sync() {
+    return flushBuffer() ? 0 : -1;
+}
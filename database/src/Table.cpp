@@ -1,95 +1,516 @@
 #include "Table.hpp"
+#include "Csv.hpp"
+#include "Value.hpp"
+#include "../adt/ChainingHashTable.hpp"
 #include <fstream>
-#include <sstream>
+#include <iterator>
 #include <algorithm>
+#include <mutex>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
 #include <thread>
 #include <chrono>
-#include <iostream>
 
 
+namespace {
+
+filesystem::path deletedPath(const filesystem::path& file) {
+    filesystem::path path = file;
+    path.replace_extension(".del");
+    return path;
+}
+
+filesystem::path zonePath(const filesystem::path& file) {
+    filesystem::path path = file;
+    path.replace_extension(".zone");
+    return path;
+}
+
+filesystem::path bloomPath(const filesystem::path& file) {
+    filesystem::path path = file;
+    path.replace_extension(".bloom");
+    return path;
+}
+
+// Calls onRow(batch, r) for every row the cursor yields, in order.
+template<typename F>
+void forEachRow(TableCursor& cursor, F&& onRow) {
+    RowBatch batch;
+    while (cursor.nextBatch(batch)) {
+        for (size_t r = 0; r < batch.rows; ++r) {
+            onRow(batch, r);
+        }
+    }
+}
+
+void sortSegments(Array<Segment>& list) {
+    list.sort([](const Segment& a, const Segment& b) {
+        string sa = a.file.stem().string();
+        string sb = b.file.stem().string();
+        try {
+            return stoi(sa) < stoi(sb);
+        } catch (...) {
+            return sa < sb;
+        }
+    });
+}
+
+void syncPath(const filesystem::path& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw runtime_error("Cannot open " + path.string() + ": " + strerror(errno));
+    }
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    if (!ok) {
+        throw runtime_error("Cannot sync " + path.string() + ": " + strerror(errno));
+    }
+}
+
+// Segments are named by number; the pk index refers to them that way.
+bool segmentNumber(const filesystem::path& file, size_t& number) {
+    string stem = file.stem().string();
+    if (stem.empty() || stem.find_first_not_of("0123456789") != string::npos) return false;
+    number = stoull(stem);
+    return true;
+}
+
+const char PK_INDEX_MAGIC[] = "DBPKIDX1";
+const char INDEX_MAGIC[] = "DBIDX001";
+// Goes into every B+tree tag; changes with the encodeOrderedKey format so
+// trees keyed the old way are rebuilt.
+const char ORDERED_KEY_FORMAT[] = "DBOKEY02";
+const char ZONE_MAGIC[] = "DBZONE02";
+const char BLOOM_MAGIC[] = "DBBLOOM1";
+
+void putU64(string& out, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        out += static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+}
+
+uint64_t getU64(const string& data, size_t& pos) {
+    if (data.size() - pos < 8) throw runtime_error("Truncated index file");
+    uint64_t value = 0;
+    for (int i = 0; i < 8; ++i) {
+        value |= static_cast<uint64_t>(static_cast<unsigned char>(data[pos + i])) << (8 * i);
+    }
+    pos += 8;
+    return value;
+}
+
+string getString(const string& data, size_t& pos) {
+    size_t length = getU64(data, pos);
+    if (data.size() - pos < length) throw runtime_error("Truncated index file");
+    string value = data.substr(pos, length);
+    pos += length;
+    return value;
+}
+
+void putString(string& out, const string& value) {
+    putU64(out, value.size());
+    out += value;
+}
+
+string serializeZoneMap(const ZoneMap& zone) {
+    string data(ZONE_MAGIC, 8);
+    putU64(data, zone.rows);
+    putU64(data, zone.min.getSize());
+    for (size_t c = 0; c < zone.min.getSize(); ++c) {
+        putU64(data, static_cast<uint64_t>(zone.types.at(c)));
+        putU64(data, zone.nulls.at(c));
+        putString(data, zone.min.at(c));
+        putString(data, zone.max.at(c));
+    }
+    return data;
+}
+
+// False unless data is the zone map of a segment of rows rows with columns
+// of the given types.
+bool parseZoneMap(const string& data, size_t rows, const Array<ColumnType>& types, ZoneMap& zone) {
+    try {
+        if (data.compare(0, 8, ZONE_MAGIC) != 0) return false;
+        size_t pos = 8;
+        zone.rows = getU64(data, pos);
+        size_t columns = getU64(data, pos);
+        if (zone.rows != rows || (rows > 0 && columns != types.getSize())) return false;
+        zone.types = types;
+        for (size_t c = 0; c < columns; ++c) {
+            if (getU64(data, pos) != static_cast<uint64_t>(types.at(c))) return false;
+            zone.nulls.append(getU64(data, pos));
+            zone.min.append(getString(data, pos));
+            zone.max.append(getString(data, pos));
+        }
+        return pos == data.size();
+    } catch (const runtime_error&) {
+        return false;
+    }
+}
+
+// True for a range with an empty bound, which no cell lies in.
+bool emptyBound(const ColumnRange& range) {
+    return !range.equality && ((range.hasLow && range.low.empty()) || (range.hasHigh && range.high.empty()));
+}
+
+// False when no cell of the column the zone map covers can lie in range.
+bool zoneAdmits(const ZoneMap& zone, const ColumnRange& range) {
+    if (zone.rows == 0) return false;
+    size_t c = range.column;
+    if (c >= zone.min.getSize()) return true;
+    ColumnType type = zone.types.at(c);
+    if (range.equality && range.low.empty()) return zone.nulls.at(c) > 0;
+    if (zone.nulls.at(c) == zone.rows || emptyBound(range)) return false;
+    if (range.equality) {
+        return compareCells(type, zone.min.at(c), range.low) <= 0 && compareCells(type, range.low, zone.max.at(c)) <= 0;
+    }
+    return (!range.hasLow || compareCells(type, zone.max.at(c), range.low) >= 0) &&
+           (!range.hasHigh || compareCells(type, zone.min.at(c), range.high) <= 0);
+}
+
+SegmentBlooms makeBlooms(const Array<size_t>& columns, size_t rows, double falsePositiveRate) {
+    SegmentBlooms blooms;
+    blooms.columns = columns;
+    for (size_t i = 0; i < columns.getSize(); ++i) {
+        blooms.filters.append(BloomFilter(rows, falsePositiveRate));
+    }
+    return blooms;
+}
+
+void addToBlooms(SegmentBlooms& blooms, const Array<string>& cells, size_t offset) {
+    for (size_t i = 0; i < blooms.columns.getSize(); ++i) {
+        blooms.filters.at(i).add(cells.at(offset + blooms.columns.at(i)));
+    }
+    blooms.rows++;
+}
+
+string serializeBlooms(const SegmentBlooms& blooms) {
+    string data(BLOOM_MAGIC, 8);
+    putU64(data, blooms.rows);
+    putU64(data, blooms.columns.getSize());
+    for (size_t i = 0; i < blooms.columns.getSize(); ++i) {
+        putU64(data, blooms.columns.at(i));
+        putString(data, blooms.filters.at(i).serialize());
+    }
+    return data;
+}
+
+// False unless data holds the filters of exactly columns for a segment of
+// rows rows.
+bool parseBlooms(const string& data, size_t rows, const Array<size_t>& columns, SegmentBlooms& blooms) {
+    try {
+        if (data.compare(0, 8, BLOOM_MAGIC) != 0) return false;
+        size_t pos = 8;
+        blooms.rows = getU64(data, pos);
+        if (blooms.rows != rows || getU64(data, pos) != columns.getSize()) return false;
+        for (size_t i = 0; i < columns.getSize(); ++i) {
+            if (getU64(data, pos) != columns.at(i)) return false;
+            blooms.columns.append(columns.at(i));
+            blooms.filters.append(BloomFilter::deserialize(getString(data, pos)));
+        }
+        return pos == data.size();
+    } catch (const runtime_error&) {
+        return false;
+    }
+}
+
+// False when the segment's filter on the column shows it cannot hold the
+// value an equality asks for.
+bool bloomAdmits(const SegmentBlooms& blooms, const ColumnRange& range) {
+    if (!range.equality) return true;
+    for (size_t i = 0; i < blooms.columns.getSize(); ++i) {
+        if (blooms.columns.at(i) == range.column) return blooms.filters.at(i).mayContain(range.low);
+    }
+    return true;
+}
+
+// Replaces path with data through a synced temporary file.
+void writeFileAtomically(const filesystem::path& path, const string& data) {
+    filesystem::path tmp = path;
+    tmp += ".tmp";
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw runtime_error("Cannot write " + tmp.string() + ": " + strerror(errno));
+    }
+    size_t written = 0;
+    bool ok = true;
+    while (ok && written < data.size()) {
+        ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+        if (n < 0 && errno == EINTR) continue;
+        ok = n > 0;
+        if (ok) written += static_cast<size_t>(n);
+    }
+    ok = ok && fsync(fd) == 0;
+    close(fd);
+    if (!ok) {
+        throw runtime_error("Cannot write " + tmp.string() + ": " + strerror(errno));
+    }
+    filesystem::rename(tmp, path);
+}
+
+void addKey(ChainingHashTable<string, Array<string>>& keys, const string& value, const string& key) {
+    Array<string>* bucket = keys.getPointer(value);
+    if (bucket == nullptr) {
+        keys.insert(value, Array<string>());
+        bucket = keys.getPointer(value);
+    }
+    bucket->append(key);
+}
+
+void removeKey(ChainingHashTable<string, Array<string>>& keys, const string& value, const string& key) {
+    Array<string>* bucket = keys.getPointer(value);
+    if (bucket == nullptr) return;
+    for (size_t i = 0; i < bucket->getSize(); ++i) {
+        if (bucket->at(i) != key) continue;
+        bucket->removeAt(i);
+        break;
+    }
+    if (bucket->empty()) keys.remove(value);
+}
+
+// FNV-1a, to fit a fingerprint into a B+tree tag.
+uint64_t hashBytes(const string& data) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (char c : data) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Length of the leading complete records of a CSV file: up to the last
+// newline outside a quoted field. Escaped quotes toggle the state twice.
+size_t completeLength(string_view data) {
+    size_t complete = 0;
+    bool quoted = false;
+    for (size_t i = 0; i < data.size(); ++i) {
+        if (data[i] == '"') {
+            quoted = !quoted;
+        } else if (data[i] == '\n' && !quoted) {
+            complete = i + 1;
+        }
+    }
+    return complete;
+}
+
+string orderedValueKey(ColumnType type, const string& value, size_t limit) {
+    string key = encodeOrderedKey(type, value);
+    if (key.size() > limit) key.resize(limit);
+    return key;
+}
+
+Array<string> emptyRow(size_t width) {
+    Array<string> row;
+    for (size_t c = 0; c < width; ++c) {
+        row.append(string());
+    }
+    return row;
+}
+
+}
+
 Table::Table(const TableConfig & config) : config(config) {
     filesystem::create_directories(config.basePath);
     pkColumnName = config.name + "_pk";
     pkSequenceFile = config.basePath / (config.name + "_pk_sequence");
-    lockFile = config.basePath / (config.name + "_lock");
+    pkIndexFile = config.basePath / (config.name + "_pk_index");
+    accessLock = make_shared<shared_mutex>();
+    fileLock = make_shared<FileLock>(config.basePath / (config.name + "_lock"));
     
-    if (!filesystem::exists(pkSequenceFile)) {
-        ofstream f(pkSequenceFile);
-        f << 0;
+    rowTypes.append(ColumnType::Untyped);
+    for (size_t i = 0; i < config.columns.getSize(); ++i) {
+        rowTypes.append(i < config.types.getSize() ? config.types.at(i) : ColumnType::Untyped);
+    }
+    for (size_t i = 0; i < config.bloomColumns.getSize(); ++i) {
+        size_t column = findColumn(config.bloomColumns.at(i));
+        if (column != 0) bloomColumns.append(column);
+    }
+    segments = make_shared<Segments>();
+    commitQueue = make_shared<CommitQueue>();
+    loadSegments();
+
+    idSequence = make_shared<IdSequence>();
+    size_t reserved = 0;
+    ifstream f(pkSequenceFile);
+    if (f.is_open()) {
+        f >> reserved;
+    }
+    idSequence->last = reserved;
+    idSequence->reserved = reserved;
+    if (!f.is_open()) {
+        reserveIds(reserved);
+    }
+
+    pkIndex = make_shared<PkIndex>();
+    loadPkIndex();
+
+    indexes = make_shared<Array<shared_ptr<SecondaryIndex>>>();
+    for (size_t i = 0; i < config.indexes.getSize(); ++i) {
+        // Columns dropped from schema.json lose their index.
+        size_t column = findColumn(config.indexes.at(i).column);
+        if (column == 0 || findIndex(column) != nullptr) continue;
+        auto index = make_shared<SecondaryIndex>();
+        index->column = column;
+        index->ordered = config.indexes.at(i).ordered;
+        if (index->ordered) index->tree = make_unique<BTree>(indexFile(*index));
+        loadIndex(*index);
+        indexes->append(std::move(index));
     }
 }
 
 void Table::lock() {
-    int retries = 0;
-    while (filesystem::exists(lockFile)) {
-        this_thread::sleep_for(chrono::milliseconds(10));
-        retries++;
-        if (retries > 1000) {
-             throw runtime_error("Table lock timeout");
-        }
-    }
-    ofstream f(lockFile);
-    f << "locked";
+    fileLock->lock();
 }
 
 void Table::unlock() {
-    filesystem::remove(lockFile);
+    fileLock->unlock();
 }
 
 size_t Table::getNextId() {
-    ifstream ifile(pkSequenceFile);
-    size_t id = 0;
-    if (ifile.is_open()) {
-        ifile >> id;
+    size_t id = idSequence->last.fetch_add(1) + 1;
+    if (id > idSequence->reserved.load()) {
+        lock_guard<mutex> guard(idSequence->refill);
+        size_t reserved = idSequence->reserved.load();
+        if (id > reserved) {
+            size_t upTo = reserved + ID_BLOCK_SIZE;
+            while (upTo < id) upTo += ID_BLOCK_SIZE;
+            reserveIds(upTo);
+            idSequence->reserved = upTo;
+        }
     }
-    id++;
-    ifile.close();
-    
-    ofstream ofile(pkSequenceFile);
-    ofile << id;
     return id;
 }
 
+// Durably replaces the sequence file: the new value is synced to a temporary
+// file and renamed over the old one, so a crash leaves either block end.
+void Table::reserveIds(size_t upTo) {
+    filesystem::path tmp = pkSequenceFile;
+    tmp += ".tmp";
+    string value = to_string(upTo);
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw runtime_error("Cannot write " + tmp.string() + ": " + strerror(errno));
+    }
+    bool ok = ::write(fd, value.data(), value.size()) == static_cast<ssize_t>(value.size()) && fsync(fd) == 0;
+    close(fd);
+    if (!ok) {
+        throw runtime_error("Cannot write " + tmp.string() + ": " + strerror(errno));
+    }
+    filesystem::rename(tmp, pkSequenceFile);
+}
+
 const Array<string>& Table::getColumns() const {
     return config.columns;
 }
 
+const Array<ColumnType>& Table::getColumnTypes() const {
+    return rowTypes;
+}
+
 string Table::getPkColumnName() const {
     return pkColumnName;
 }
 
+shared_lock<shared_mutex> Table::lockForRead() const {
+    return shared_lock<shared_mutex>(*accessLock);
+}
+
+unique_lock<shared_mutex> Table::lockForWrite() {
+    return unique_lock<shared_mutex>(*accessLock);
+}
+
+Array<string> Table::canonicalRow(const Array<string>& values) const {
+    if (values.getSize() != config.columns.getSize()) {
+        throw runtime_error("Column count mismatch. Expected " + to_string(config.columns.getSize()) + " values, got " + to_string(values.getSize()));
+    }
+    Array<string> row;
+    for (size_t i = 0; i < values.getSize(); ++i) {
+        ColumnType type = rowTypes.at(i + 1);
+        string cell;
+        if (!canonicalValue(type, values.at(i), cell)) {
+            throw runtime_error("Invalid " + string(columnTypeName(type)) + " value '" + values.at(i) +
+                                "' for column " + config.columns.at(i));
+        }
+        row.append(std::move(cell));
+    }
+    return row;
+}
+
 void Table::insert(const Array<string>& values) {
+    Array<string> row = canonicalRow(values);
+    CommitQueue& queue = *commitQueue;
+    PendingInsert request;
+    request.values = &row;
+    unique_lock<mutex> lk(queue.mtx);
+    queue.pending.append(&request);
+    while (!request.done) {
+        if (queue.leaderActive) {
+            queue.committed.wait(lk);
+            continue;
+        }
+        // Become the leader and write out everything queued so far; rows
+        // arriving meanwhile wait for the next leader.
+        queue.leaderActive = true;
+        Array<PendingInsert*> batch = std::move(queue.pending);
+        lk.unlock();
+
+        string error;
+        try {
+            Array<const Array<string>*> rows;
+            for (size_t i = 0; i < batch.getSize(); ++i) {
+                rows.append(batch.at(i)->values);
+            }
+            appendRows(rows);
+        } catch (const exception& e) {
+            error = e.what();
+        }
+
+        lk.lock();
+        for (size_t i = 0; i < batch.getSize(); ++i) {
+            batch.at(i)->error = error;
+            batch.at(i)->done = true;
+        }
+        queue.leaderActive = false;
+        queue.committed.notify_all();
+    }
+    if (!request.error.empty()) {
+        throw runtime_error(request.error);
+    }
+}
+
+void Table::insertBatch(const Array<Array<string>>& rows) {
+    Array<Array<string>> canonical;
+    for (size_t i = 0; i < rows.getSize(); ++i) {
+        canonical.append(canonicalRow(rows.at(i)));
+    }
+    Array<const Array<string>*> pointers;
+    for (size_t i = 0; i < canonical.getSize(); ++i) {
+        pointers.append(&canonical.at(i));
+    }
+    appendRows(pointers);
+}
+
+void Table::appendRows(const Array<const Array<string>*>& rows) {
+    if (rows.empty()) return;
+    unique_lock<shared_mutex> guard(*accessLock);
     lock();
     try {
-        size_t id = getNextId();
-        Array<string> fullRow;
-        fullRow.append(to_string(id));
-        for (size_t i = 0; i < values.getSize(); ++i) {
-            fullRow.append(values.at(i));
-        }
-
-        if (fullRow.getSize() != config.columns.getSize() + 1) {
-            throw runtime_error("Column count mismatch. Expected " + to_string(config.columns.getSize()) + " values, got " + to_string(values.getSize()));
-        }
-        
-        filesystem::path file = getCurrentDataFilePath();
-        bool newFile = !filesystem::exists(file);
-        
-        ofstream f(file, ios::app);
-        if (newFile) {
-            f << pkColumnName;
-            for (size_t i = 0; i < config.columns.getSize(); ++i) {
-                f << "," << config.columns.at(i);
-            }
-            f << "\n";
-        }
-        
-        for (size_t i = 0; i < fullRow.getSize(); ++i) {
-            if (i > 0) f << ",";
-            f << fullRow.at(i);
-        }
-        f << "\n";
-        
+        WalRecord record;
+        record.kind = WalRecord::Kind::Insert;
+        record.table = config.name;
+        for (size_t r = 0; r < rows.getSize(); ++r) {
+            Array<string> fullRow;
+            fullRow.append(to_string(getNextId()));
+            const Array<string>& values = *rows.at(r);
+            for (size_t i = 0; i < values.getSize(); ++i) {
+                fullRow.append(values.at(i));
+            }
+            record.rows.append(std::move(fullRow));
+        }
+        if (config.wal) config.wal->append(record);
+        writeRows(record.rows);
     } catch (...) {
         unlock();
         throw;
@@ -97,136 +518,1168 @@ void Table::insert(const Array<string>& values) {
     unlock();
 }
 
-Array<Array<string>> Table::scan() {
-    Array<Array<string>> allRows;
-    auto files = getDataFiles();
-    for (size_t i = 0; i < files.getSize(); ++i) {
-        ifstream f(files.at(i));
-        string line;
-        bool header = true;
-        while (getline(f, line)) {
-            if (line.empty()) continue;
-            if (header) {
-                header = false;
-                continue;
+void Table::writeRows(const Array<Array<string>>& rows) {
+    if (rows.empty()) return;
+    ofstream* f = nullptr;
+    string line;
+    for (size_t r = 0; r < rows.getSize(); ++r) {
+        f = &activeSegment();
+        const Array<string>& row = rows.at(r);
+        line.clear();
+        for (size_t i = 0; i < row.getSize(); ++i) {
+            if (i > 0) line += ',';
+            appendCsvField(line, row.at(i));
+        }
+        line += '\n';
+        f->write(line.data(), static_cast<streamsize>(line.size()));
+        Segment& segment = segments->list.at(segments->list.getSize() - 1);
+        RowLocation location;
+        if (segmentNumber(segment.file, location.segment)) {
+            location.ordinal = segment.rows;
+            location.offset = segments->appendOffset;
+            pkIndex->rows.insert(row.at(0), location);
+        } else {
+            pkIndex->complete = false;
+        }
+        pkIndex->dirty = true;
+        for (size_t i = 0; i < indexes->getSize(); ++i) {
+            SecondaryIndex& index = *indexes->at(i);
+            addToIndex(index, row.at(index.column), row.at(0));
+        }
+        segments->appendOffset += line.size();
+        segment.rows++;
+    }
+    f->flush();
+    if (!*f) {
+        segments->appender.close();
+        throw runtime_error("Failed to append to " + segments->list.at(segments->list.getSize() - 1).file.string());
+    }
+}
+
+TableCursor::TableCursor(Array<Segment> segments, size_t width, Array<bool> columns,
+                         const Array<ColumnRange>& ranges)
+    : segments(std::move(segments)), width(width), columns(std::move(columns)) {
+    for (size_t i = 0; i < this->segments.getSize(); ++i) {
+        const Segment& segment = this->segments.at(i);
+        bool zoned = true;
+        bool bloomed = true;
+        for (size_t r = 0; r < ranges.getSize() && zoned && segment.zone; ++r) {
+            zoned = zoneAdmits(*segment.zone, ranges.at(r));
+        }
+        for (size_t r = 0; r < ranges.getSize() && zoned && bloomed && segment.blooms; ++r) {
+            bloomed = bloomAdmits(*segment.blooms, ranges.at(r));
+        }
+        if (!zoned) {
+            zoneSkipped++;
+        } else if (!bloomed) {
+            bloomSkipped++;
+        } else {
+            scanned.append(i);
+        }
+    }
+    mapTail();
+}
+
+TableCursor::TableCursor(Array<Segment> segments, size_t width, Array<bool> columns, Array<RowLocation> targets)
+    : segments(std::move(segments)), width(width), columns(std::move(columns)), lookup(true),
+      targets(std::move(targets)) {
+    mapTail();
+}
+
+void TableCursor::mapTail() {
+    size_t end = lookup ? targets.getSize() : scanned.getSize();
+    if (end == 0) return;
+    size_t last = lookup ? targets.at(end - 1).segment : scanned.at(end - 1);
+    if (last + 1 == segments.getSize()) tail = mapSegment(last);
+}
+
+shared_ptr<const MappedFile> TableCursor::mapSegment(size_t segment) const {
+    if (segment + 1 == segments.getSize() && tail) return tail;
+    // Lookups read scattered rows, so read-ahead would only waste I/O.
+    MappedFile::Access access = lookup ? MappedFile::Access::Random : MappedFile::Access::Sequential;
+    const Segment& target = segments.at(segment);
+    return target.handle ? target.handle->map(access) : make_shared<const MappedFile>(target.file, access);
+}
+
+TableCursor::~TableCursor() {
+    close();
+}
+
+bool TableCursor::nextBatch(RowBatch& batch) {
+    if (batch.width != width) {
+        batch = RowBatch();
+        batch.width = width;
+    }
+    batch.rows = 0;
+    size_t end = lookup ? targets.getSize() : scanned.getSize();
+    while (batch.rows < BATCH_ROWS && current < end) {
+        size_t segment = lookup ? targets.at(current).segment : scanned.at(current);
+        if (!reader || readerSegment != segment) {
+            if (!lookup && current + 1 < end) prefetchFile(segments.at(scanned.at(current + 1)).file);
+            reader = make_unique<SegmentReader>(segments.at(segment), width, columns.empty() ? nullptr : &columns,
+                                                mapSegment(segment));
+            readerSegment = segment;
+        }
+        size_t r = batch.rows;
+        if (batch.cells.getSize() < (r + 1) * width) {
+            for (size_t c = 0; c < width; ++c) {
+                batch.cells.append(string());
             }
-            
-            Array<string> row;
-            stringstream ss(line);
-            string cell;
-            while (getline(ss, cell, ',')) {
-                row.append(cell);
+            batch.locations.append(RowLocation());
+        }
+        bool found = false;
+        if (lookup) {
+            found = reader->readAt(targets.at(current++), batch.cells, r * width);
+        } else {
+            found = reader->next(batch.cells, r * width);
+            if (!found) {
+                reader.reset();
+                current++;
             }
-            allRows.append(row);
         }
+        if (!found) continue;
+        RowLocation& location = batch.locations.at(r);
+        location.segment = segment;
+        location.ordinal = reader->getOrdinal();
+        location.offset = reader->getOffset();
+        batch.rows++;
+    }
+    return batch.rows > 0;
+}
+
+void TableCursor::close() {
+    reader.reset();
+    tail.reset();
+    current = lookup ? targets.getSize() : scanned.getSize();
+}
+
+size_t TableCursor::getZoneSkipped() const {
+    return zoneSkipped;
+}
+
+size_t TableCursor::getBloomSkipped() const {
+    return bloomSkipped;
+}
+
+TableCursor Table::openScan(Array<bool> columns, const Array<ColumnRange>& bounds) const {
+    return TableCursor(segments->list, getWidth(), std::move(columns), bounds);
+}
+
+TableCursor Table::openLookup(const ColumnRange& range, Array<bool> columns) const {
+    Array<string> keys;
+    if (!lookupKeys(range, keys)) {
+        Array<ColumnRange> bounds;
+        bounds.append(range);
+        return openScan(std::move(columns), bounds);
     }
-    return allRows;
+    return TableCursor(segments->list, getWidth(), std::move(columns), locate(keys));
 }
 
-void Table::deleteRows(const function<bool(const Array<string>&, const Array<string>&)>& predicate) {
+// Primary keys of the rows whose cell may lie in range; false when no
+// index answers that, or when the rows named are more than a quarter of
+// the table and reading them one by one would cost more than a scan.
+bool Table::lookupKeys(const ColumnRange& range, Array<string>& keys) const {
+    if (!pkIndex->complete || !hasIndex(range)) return false;
+    if (range.column == 0) {
+        keys.append(range.low);
+        return true;
+    }
+    size_t live = 0;
+    for (size_t i = 0; i < segments->list.getSize(); ++i) {
+        live += segments->list.at(i).rows - segments->list.at(i).deleted.count();
+    }
+    size_t limit = live / 4 > 1 ? live / 4 : 1;
+
+    const SecondaryIndex* index = findIndex(range.column);
+    if (!index->ordered) {
+        const Array<string>* found = index->keys.getPointer(range.low);
+        if (found == nullptr) return true;
+        if (found->getSize() > limit) return false;
+        keys = *found;
+        return true;
+    }
+    // Bounds are cut like the stored values, so a long value still falls
+    // inside; the caller's filters drop what lies just outside. Nulls are
+    // in no range but an equality with ''.
+    if (emptyBound(range)) return true;
+    bool hasHigh = range.equality || range.hasHigh;
+    ColumnType type = rowTypes.at(range.column);
+    string null = orderedValueKey(type, string(), MAX_ORDERED_VALUE_BYTES);
+    string from = range.hasLow || range.equality ? orderedValueKey(type, range.low, MAX_ORDERED_VALUE_BYTES) : string();
+    string to = hasHigh ? orderedValueKey(type, range.equality ? range.low : range.high, MAX_ORDERED_VALUE_BYTES) + '\xFF'
+                        : string();
+    bool withinLimit = true;
+    index->tree->scan(range.hasLow || range.equality ? &from : nullptr, hasHigh ? &to : nullptr,
+                      [&](string_view entry, string_view key) {
+        if (!range.equality && entry.compare(0, null.size(), null) == 0) return true;
+        keys.append(string(key));
+        withinLimit = keys.getSize() <= limit;
+        return withinLimit;
+    });
+    return withinLimit;
+}
+
+// Locations of the given keys in file order, with segment as an index
+// into the current list. Keys that are not in the index are left out.
+Array<RowLocation> Table::locate(const Array<string>& keys) const {
+    Array<RowLocation> locations;
+    for (size_t i = 0; i < keys.getSize(); ++i) {
+        const RowLocation* found = pkIndex->rows.getPointer(keys.at(i));
+        if (found == nullptr) continue;
+        RowLocation location = *found;
+        location.segment = findSegment(found->segment);
+        if (location.segment < segments->list.getSize()) locations.append(location);
+    }
+    // Keys are mostly stored in insertion order already, which keeps the
+    // sort cheap.
+    locations.sort([](const RowLocation& a, const RowLocation& b) {
+        return a.segment < b.segment || (a.segment == b.segment && a.ordinal < b.ordinal);
+    });
+    return locations;
+}
+
+// Index in the list of the segment with the given number, or the list size.
+// The list is sorted by number whenever every segment has one.
+size_t Table::findSegment(size_t number) const {
+    const Array<Segment>& list = segments->list;
+    size_t low = 0;
+    size_t high = list.getSize();
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        size_t current = 0;
+        segmentNumber(list.at(middle).file, current);
+        if (current == number) return middle;
+        if (current < number) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return list.getSize();
+}
+
+size_t Table::getWidth() const {
+    return config.columns.getSize() + 1;
+}
+
+size_t Table::deleteRows(const function<bool(const Array<string>&, const Array<string>&)>& predicate,
+                         const ColumnRange* range, const Array<ColumnRange>& bounds) {
+    unique_lock<shared_mutex> guard(*accessLock);
     lock();
+    size_t deleted = 0;
     try {
-        auto files = getDataFiles();
-        Array<string> allColumns;
-        allColumns.append(pkColumnName);
-        for (size_t i = 0; i < config.columns.getSize(); ++i) {
-            allColumns.append(config.columns.at(i));
-        }
-
-        for (size_t i = 0; i < files.getSize(); ++i) {
-            ifstream f(files.at(i));
-            string line;
-            Array<string> linesToKeep;
-            bool header = true;
-            string headerLine;
-            bool modified = false;
-            
-            while (getline(f, line)) {
-                if (line.empty()) continue;
-                if (header) {
-                    headerLine = line;
-                    header = false;
-                    continue;
+        Array<string> keys;
+        bool indexed = range != nullptr && lookupKeys(*range, keys);
+        deleted = removeRows(predicate, true, indexed ? &keys : nullptr, bounds);
+    } catch (...) {
+        unlock();
+        throw;
+    }
+    unlock();
+    return deleted;
+}
+
+// Marks matching rows in the segments' deleted bitmaps; the data files
+// themselves are left alone until compaction.
+size_t Table::removeRows(const function<bool(const Array<string>&, const Array<string>&)>& predicate, bool logged,
+                         const Array<string>* keys, const Array<ColumnRange>& bounds) {
+    size_t deleted = 0;
+    Array<string> allColumns;
+    allColumns.append(pkColumnName);
+    for (size_t i = 0; i < config.columns.getSize(); ++i) {
+        allColumns.append(config.columns.at(i));
+    }
+    Array<string> row = emptyRow(allColumns.getSize());
+
+    // Matches are collected per segment first: the cursor reads a snapshot
+    // of the list, and the bitmaps are only updated once it is done.
+    Array<WalRecord> records;
+    Array<Array<size_t>> matches;
+    // Cells of the indexed columns of every match, one run per row.
+    Array<Array<string>> indexedValues;
+    for (size_t i = 0; i < segments->list.getSize(); ++i) {
+        WalRecord record;
+        record.kind = WalRecord::Kind::Delete;
+        record.table = config.name;
+        records.append(std::move(record));
+        matches.append(Array<size_t>());
+        indexedValues.append(Array<string>());
+    }
+    // Restricted to the given keys, only the rows the pk index points at
+    // are read.
+    unique_ptr<TableCursor> cursor;
+    if (keys != nullptr && pkIndex->complete) {
+        cursor = make_unique<TableCursor>(segments->list, row.getSize(), Array<bool>(), locate(*keys));
+    } else {
+        cursor = make_unique<TableCursor>(segments->list, row.getSize(), Array<bool>(), bounds);
+    }
+    forEachRow(*cursor, [&](RowBatch& batch, size_t r) {
+        for (size_t c = 0; c < row.getSize(); ++c) {
+            row.at(c).swap(batch.cell(r, c));
+        }
+        if (predicate(row, allColumns)) {
+            size_t segment = batch.locations.at(r).segment;
+            matches.at(segment).append(batch.locations.at(r).ordinal);
+            records.at(segment).keys.append(row.at(0));
+            for (size_t k = 0; k < indexes->getSize(); ++k) {
+                indexedValues.at(segment).append(row.at(indexes->at(k)->column));
+            }
+        }
+    });
+
+    for (size_t i = 0; i < segments->list.getSize(); ++i) {
+        if (matches.at(i).empty()) continue;
+        Segment& segment = segments->list.at(i);
+        if (logged && config.wal) config.wal->append(records.at(i));
+        for (size_t j = 0; j < matches.at(i).getSize(); ++j) {
+            segment.deleted.set(matches.at(i).at(j));
+            pkIndex->rows.remove(records.at(i).keys.at(j));
+            for (size_t k = 0; k < indexes->getSize(); ++k) {
+                removeFromIndex(*indexes->at(k), indexedValues.at(i).at(j * indexes->getSize() + k),
+                                records.at(i).keys.at(j));
+            }
+        }
+        pkIndex->dirty = true;
+        saveDeleted(segment);
+        deleted += matches.at(i).getSize();
+    }
+    return deleted;
+}
+
+// Replaces the bitmap file through a rename so it is never seen half
+// written; the WAL covers a crash before the new file reaches the disk.
+void Table::saveDeleted(const Segment& segment) {
+    filesystem::path path = deletedPath(segment.file);
+    filesystem::path tmp = path;
+    tmp += ".tmp";
+    {
+        ofstream of(tmp, ios::binary | ios::trunc);
+        of << segment.deleted.serialize();
+        if (!of) throw runtime_error("Failed to write " + path.string());
+    }
+    filesystem::rename(tmp, path);
+}
+
+void Table::recover(const Array<const WalRecord*>& records) {
+    if (records.empty()) return;
+    unique_lock<shared_mutex> guard(*accessLock);
+    lock();
+    try {
+        // Rows already on disk are found through the pk index when it
+        // covers the table, otherwise by scanning for their keys.
+        ChainingHashTable<string, bool> scanned;
+        if (!pkIndex->complete) {
+            TableCursor cursor(segments->list, getWidth());
+            forEachRow(cursor, [&](const RowBatch& batch, size_t r) {
+                scanned.insert(batch.cell(r, 0), true);
+            });
+        }
+        ChainingHashTable<string, bool> added;
+        ChainingHashTable<string, bool> removed;
+        auto present = [&](const string& key) {
+            if (removed.find(key)) return false;
+            if (added.find(key)) return true;
+            return pkIndex->complete ? pkIndex->rows.find(key) : scanned.find(key);
+        };
+
+        Array<Array<string>> missing;
+        Array<string> removedKeys;
+        for (size_t r = 0; r < records.getSize(); ++r) {
+            const WalRecord& record = *records.at(r);
+            if (record.kind == WalRecord::Kind::Insert) {
+                for (size_t i = 0; i < record.rows.getSize(); ++i) {
+                    const string& key = record.rows.at(i).at(0);
+                    if (present(key) || removed.find(key)) continue;
+                    added.insert(key, true);
+                    missing.append(record.rows.at(i));
                 }
-                
-                Array<string> row;
-                stringstream ss(line);
-                string cell;
-                while (getline(ss, cell, ',')) {
-                    row.append(cell);
+            } else {
+                for (size_t i = 0; i < record.keys.getSize(); ++i) {
+                    if (present(record.keys.at(i))) {
+                        removed.insert(record.keys.at(i), true);
+                        removedKeys.append(record.keys.at(i));
+                    }
                 }
-                
-                if (!predicate(row, allColumns)) {
-                    linesToKeep.append(line);
-                } else {
-                    modified = true;
+            }
+        }
+
+        writeRows(missing);
+        if (!removedKeys.empty()) {
+            removeRows([&removed](const Array<string>& values, const Array<string>&) {
+                return removed.find(values.at(0));
+            }, false, &removedKeys);
+        }
+    } catch (...) {
+        unlock();
+        throw;
+    }
+    unlock();
+}
+
+void Table::syncToDisk() {
+    if (segments->appender.is_open()) segments->appender.flush();
+    savePkIndex();
+    for (size_t i = 0; i < indexes->getSize(); ++i) {
+        saveIndex(*indexes->at(i));
+    }
+    Array<filesystem::path> paths;
+    for (size_t i = 0; i < segments->list.getSize(); ++i) {
+        const Segment& segment = segments->list.at(i);
+        paths.append(segment.file);
+        if (!segment.deleted.empty()) paths.append(deletedPath(segment.file));
+    }
+    paths.append(config.basePath);
+    for (size_t i = 0; i < paths.getSize(); ++i) {
+        syncPath(paths.at(i));
+    }
+}
+
+namespace {
+
+// One merged output of a compaction run: where each of its rows came from,
+// so deletes that land while the copy runs can be carried over.
+struct CompactedSegment {
+    filesystem::path target;
+    // The name the pending files are written under. The same as target
+    // unless the output is numbered only at the swap.
+    filesystem::path staged;
+    filesystem::path tmp;
+    // The rows as CSV; the same file as tmp unless the table is columnar.
+    filesystem::path text;
+    Array<size_t> sourceSegment;
+    Array<size_t> sourceOrdinal;
+    // Primary key and record offset of each row, for the pk index.
+    Array<string> keys;
+    Array<size_t> offsets;
+    size_t bytes = 0;
+    ZoneMap zone;
+    SegmentBlooms blooms;
+};
+
+const char* COMPACTION_MANIFEST = "compaction";
+
+filesystem::path pendingPath(const filesystem::path& path) {
+    filesystem::path pending = path;
+    pending += ".compact";
+    return pending;
+}
+
+}
+
+CompactionStats Table::compact(size_t bytesPerSecond) {
+    lock_guard<mutex> exclusive(segments->compaction);
+    CompactionStats stats;
+
+    // Sealed segments never change on disk except through compaction, so
+    // a snapshot of them can be copied without holding the table lock.
+    Array<Segment> sources;
+    {
+        shared_lock<shared_mutex> guard(*accessLock);
+        for (size_t i = 0; i + 1 < segments->list.getSize(); ++i) {
+            const Segment& segment = segments->list.at(i);
+            size_t deleted = segment.deleted.count();
+            bool underfilled = (segment.rows - deleted) * 2 < config.tuplesLimit;
+            bool sparse = deleted > 0 && deleted * 4 >= segment.rows;
+            if (underfilled || sparse) sources.append(segment);
+        }
+    }
+    if (sources.empty() || (sources.getSize() == 1 && sources.at(0).deleted.empty())) {
+        return stats;
+    }
+
+    string header = pkColumnName;
+    for (size_t i = 0; i < config.columns.getSize(); ++i) {
+        header += "," + config.columns.at(i);
+    }
+
+    Array<CompactedSegment> outputs;
+    ofstream out;
+    size_t outputRows = 0;
+    auto started = chrono::steady_clock::now();
+    size_t width = getWidth();
+    string line;
+    for (size_t s = 0; s < sources.getSize(); ++s) {
+        stats.rowsDropped += sources.at(s).deleted.count();
+    }
+    TableCursor cursor(sources, width);
+    forEachRow(cursor, [&](const RowBatch& batch, size_t r) {
+        if (outputs.empty() || outputRows >= config.tuplesLimit) {
+            out.close();
+            // Outputs reuse the names of the sources, which all sort
+            // before the active segment. Sources written under a larger
+            // tuples_limit can need more outputs than there are sources;
+            // the rest are staged under a scratch name and numbered past
+            // the last segment at the swap. Columnar outputs are written
+            // as CSV first and converted once complete.
+            CompactedSegment next;
+            size_t o = outputs.getSize();
+            next.staged = o < sources.getSize() ? sources.at(o).file
+                                                : config.basePath / ("extra" + to_string(o - sources.getSize()));
+            next.staged.replace_extension(config.columnar ? COLUMNAR_EXTENSION : CSV_EXTENSION);
+            next.target = next.staged;
+            next.tmp = pendingPath(next.staged);
+            next.text = pendingPath(filesystem::path(next.staged).replace_extension(CSV_EXTENSION));
+            out.open(next.text, ios::trunc);
+            out << header << "\n";
+            stats.bytesWritten += header.size() + 1;
+            next.bytes = header.size() + 1;
+            next.zone.types = rowTypes;
+            next.blooms = makeBlooms(bloomColumns, config.tuplesLimit, config.bloomFalsePositiveRate);
+            outputs.append(std::move(next));
+            outputRows = 0;
+        }
+        line.clear();
+        for (size_t c = 0; c < width; ++c) {
+            if (c > 0) line += ',';
+            appendCsvField(line, batch.cell(r, c));
+        }
+        out << line << "\n";
+        outputRows++;
+        CompactedSegment& output = outputs.at(outputs.getSize() - 1);
+        output.sourceSegment.append(batch.locations.at(r).segment);
+        output.sourceOrdinal.append(batch.locations.at(r).ordinal);
+        output.keys.append(batch.cell(r, 0));
+        output.offsets.append(output.bytes);
+        output.zone.addRow(batch.cells, r * width);
+        addToBlooms(output.blooms, batch.cells, r * width);
+        output.bytes += line.size() + 1;
+        stats.bytesWritten += line.size() + 1;
+
+        if (bytesPerSecond > 0) {
+            auto due = started + chrono::microseconds(stats.bytesWritten * 1000000 / bytesPerSecond);
+            if (due > chrono::steady_clock::now()) this_thread::sleep_until(due);
+        }
+    });
+    out.close();
+    // Sources with every row deleted leave no output and are just removed.
+    if (!outputs.empty() && !out) throw runtime_error("Failed to write compacted segment of " + config.name);
+    for (size_t i = 0; i < outputs.getSize(); ++i) {
+        const CompactedSegment& output = outputs.at(i);
+        if (output.text != output.tmp) {
+            writeColumnar(output.text, output.tmp, rowTypes);
+            filesystem::remove(output.text);
+        } else {
+            syncPath(output.tmp);
+        }
+        writeFileAtomically(pendingPath(zonePath(output.staged)), serializeZoneMap(output.zone));
+        if (!bloomColumns.empty()) {
+            writeFileAtomically(pendingPath(bloomPath(output.staged)), serializeBlooms(output.blooms));
+        }
+    }
+
+    unique_lock<shared_mutex> guard(*accessLock);
+    lock();
+    try {
+        size_t lastNumber = 0;
+        for (size_t i = 0; i < segments->list.getSize(); ++i) {
+            size_t number = 0;
+            if (segmentNumber(segments->list.at(i).file, number) && number > lastNumber) lastNumber = number;
+        }
+        for (size_t o = sources.getSize(); o < outputs.getSize(); ++o) {
+            CompactedSegment& output = outputs.at(o);
+            output.target = config.basePath / (to_string(++lastNumber) + output.staged.extension().string());
+        }
+
+        // Carry over deletes made since the snapshot.
+        Array<Bitmap> outputDeleted;
+        for (size_t i = 0; i < outputs.getSize(); ++i) {
+            outputDeleted.append(Bitmap());
+        }
+        for (size_t s = 0; s < sources.getSize(); ++s) {
+            for (size_t i = 0; i < segments->list.getSize(); ++i) {
+                const Segment& current = segments->list.at(i);
+                if (current.file != sources.at(s).file) continue;
+                if (current.deleted.count() == sources.at(s).deleted.count()) break;
+                for (size_t o = 0; o < outputs.getSize(); ++o) {
+                    const CompactedSegment& output = outputs.at(o);
+                    for (size_t r = 0; r < output.sourceSegment.getSize(); ++r) {
+                        if (output.sourceSegment.at(r) == s && current.deleted.test(output.sourceOrdinal.at(r))) {
+                            outputDeleted.at(o).set(r);
+                        }
+                    }
                 }
+                break;
+            }
+        }
+
+        // Every step of the swap goes into a synced manifest first, so a
+        // crash part way through is completed by finishCompaction on the
+        // next start instead of leaving rows both merged and in place.
+        string manifest;
+        for (size_t o = 0; o < outputs.getSize(); ++o) {
+            const CompactedSegment& output = outputs.at(o);
+            filesystem::path del = deletedPath(output.target);
+            if (outputDeleted.at(o).empty()) {
+                manifest += "D " + del.filename().string() + "\n";
+            } else {
+                ofstream bitmap(pendingPath(del), ios::binary | ios::trunc);
+                bitmap << outputDeleted.at(o).serialize();
+                bitmap.close();
+                syncPath(pendingPath(del));
+                manifest += "R " + pendingPath(del).filename().string() + " " + del.filename().string() + "\n";
+            }
+            manifest += "R " + output.tmp.filename().string() + " " + output.target.filename().string() + "\n";
+            filesystem::path zone = zonePath(output.target);
+            manifest += "R " + pendingPath(zonePath(output.staged)).filename().string() + " " +
+                        zone.filename().string() + "\n";
+            filesystem::path bloom = bloomPath(output.target);
+            if (bloomColumns.empty()) {
+                manifest += "D " + bloom.filename().string() + "\n";
+            } else {
+                manifest += "R " + pendingPath(bloomPath(output.staged)).filename().string() + " " +
+                            bloom.filename().string() + "\n";
+            }
+            if (o < sources.getSize() && sources.at(o).file != output.target) {
+                manifest += "D " + sources.at(o).file.filename().string() + "\n";
             }
-            f.close();
-            
-            if (modified) {
-                ofstream of(files.at(i));
-                of << headerLine << "\n";
-                for (size_t j = 0; j < linesToKeep.getSize(); ++j) {
-                    of << linesToKeep.at(j) << "\n";
+        }
+        for (size_t s = outputs.getSize(); s < sources.getSize(); ++s) {
+            manifest += "D " + sources.at(s).file.filename().string() + "\n";
+            manifest += "D " + deletedPath(sources.at(s).file).filename().string() + "\n";
+            manifest += "D " + zonePath(sources.at(s).file).filename().string() + "\n";
+            manifest += "D " + bloomPath(sources.at(s).file).filename().string() + "\n";
+        }
+        filesystem::path manifestPath = config.basePath / COMPACTION_MANIFEST;
+        {
+            ofstream f(pendingPath(manifestPath), ios::trunc);
+            f << manifest;
+            if (!f) throw runtime_error("Failed to write compaction manifest of " + config.name);
+        }
+        syncPath(pendingPath(manifestPath));
+        filesystem::rename(pendingPath(manifestPath), manifestPath);
+        syncPath(config.basePath);
+        // Cursors opened before the swap may not have reached the sources.
+        for (size_t s = 0; s < sources.getSize(); ++s) {
+            sources.at(s).handle->pin();
+        }
+        finishCompaction();
+
+        Array<Segment> list;
+        for (size_t i = 0; i < segments->list.getSize(); ++i) {
+            bool replaced = false;
+            for (size_t s = 0; s < sources.getSize(); ++s) {
+                if (segments->list.at(i).file == sources.at(s).file) replaced = true;
+            }
+            if (!replaced) list.append(std::move(segments->list.at(i)));
+        }
+        for (size_t o = 0; o < outputs.getSize(); ++o) {
+            const CompactedSegment& output = outputs.at(o);
+            RowLocation location;
+            if (segmentNumber(output.target, location.segment)) {
+                for (size_t r = 0; r < output.keys.getSize(); ++r) {
+                    if (outputDeleted.at(o).test(r)) continue;
+                    location.ordinal = r;
+                    location.offset = output.offsets.at(r);
+                    pkIndex->rows.insert(output.keys.at(r), location);
                 }
             }
+            pkIndex->dirty = true;
+
+            Segment segment;
+            segment.file = outputs.at(o).target;
+            segment.handle = make_shared<SegmentHandle>(segment.file);
+            segment.rows = outputs.at(o).sourceSegment.getSize();
+            segment.deleted = std::move(outputDeleted.at(o));
+            segment.zone = make_shared<ZoneMap>(std::move(outputs.at(o).zone));
+            if (!bloomColumns.empty()) segment.blooms = make_shared<SegmentBlooms>(std::move(outputs.at(o).blooms));
+            list.append(std::move(segment));
+        }
+        sortSegments(list);
+        segments->list = std::move(list);
+        // Outputs numbered past the active segment take its place as the
+        // last one, so appends must reopen there.
+        if (outputs.getSize() > sources.getSize()) segments->appender.close();
+        // Secondary indexes refer to rows by key and need no changes, but
+        // the segments they were saved with are gone.
+        for (size_t i = 0; i < indexes->getSize(); ++i) {
+            indexes->at(i)->dirty = true;
         }
     } catch (...) {
         unlock();
         throw;
     }
     unlock();
+
+    stats.segmentsMerged = sources.getSize();
+    stats.segmentsWritten = outputs.getSize();
+    return stats;
+}
+
+// Replays an interrupted compaction swap. Renames and removals whose
+// source is already gone were done before the crash and are skipped.
+void Table::finishCompaction() {
+    filesystem::path manifestPath = config.basePath / COMPACTION_MANIFEST;
+    ifstream f(manifestPath);
+    if (f.is_open()) {
+        string op, from, to;
+        while (f >> op >> from) {
+            if (op == "R") {
+                f >> to;
+                if (filesystem::exists(config.basePath / from)) {
+                    filesystem::rename(config.basePath / from, config.basePath / to);
+                }
+            } else {
+                filesystem::remove(config.basePath / from);
+            }
+        }
+        f.close();
+        syncPath(config.basePath);
+        filesystem::remove(manifestPath);
+    }
+    // Copies of a compaction that never reached its manifest.
+    for (const auto& entry : filesystem::directory_iterator(config.basePath)) {
+        if (entry.path().extension() == ".compact") {
+            filesystem::remove(entry.path());
+        }
+    }
 }
 
-Array<filesystem::path> Table::getDataFiles() const {
-    Array<filesystem::path> files;
-    if (!filesystem::exists(config.basePath)) return files;
+Array<Segment> Table::getSegments() const {
+    return segments->list;
+}
 
+void Table::loadSegments() {
+    finishCompaction();
+    Array<Segment>& list = segments->list;
     for (const auto& entry : filesystem::directory_iterator(config.basePath)) {
-        if (entry.path().extension() == ".csv") {
-            files.append(entry.path());
+        const filesystem::path& file = entry.path();
+        if (file.extension() != CSV_EXTENSION && file.extension() != COLUMNAR_EXTENSION) continue;
+        // A CSV segment whose columnar copy is already in place was being
+        // sealed when the process stopped.
+        if (file.extension() == CSV_EXTENSION &&
+            filesystem::exists(filesystem::path(file).replace_extension(COLUMNAR_EXTENSION))) {
+            filesystem::remove(file);
+            continue;
+        }
+        Segment segment;
+        segment.file = file;
+        segment.handle = make_shared<SegmentHandle>(file);
+        segment.rows = countRows(segment.file);
+        ifstream bitmap(deletedPath(segment.file), ios::binary);
+        if (bitmap.is_open()) {
+            string data((istreambuf_iterator<char>(bitmap)), istreambuf_iterator<char>());
+            segment.deleted = Bitmap::deserialize(data);
         }
+        ifstream zone(zonePath(segment.file), ios::binary);
+        if (zone.is_open()) {
+            string data((istreambuf_iterator<char>(zone)), istreambuf_iterator<char>());
+            auto map = make_shared<ZoneMap>();
+            if (parseZoneMap(data, segment.rows, rowTypes, *map)) segment.zone = std::move(map);
+        }
+        ifstream bloom(bloomPath(segment.file), ios::binary);
+        if (bloom.is_open() && !bloomColumns.empty()) {
+            string data((istreambuf_iterator<char>(bloom)), istreambuf_iterator<char>());
+            auto blooms = make_shared<SegmentBlooms>();
+            if (parseBlooms(data, segment.rows, bloomColumns, *blooms)) segment.blooms = std::move(blooms);
+        }
+        list.append(std::move(segment));
+    }
+    sortSegments(list);
+    if (!list.empty() && !isColumnar(list.at(list.getSize() - 1).file)) {
+        trimTornRecord(list.at(list.getSize() - 1));
     }
-    files.sort([](const filesystem::path& a, const filesystem::path& b) {
-        string sa = a.stem().string();
-        string sb = b.stem().string();
+    // CSV files dropped into a columnar table, or written before it was
+    // switched to columnar storage, are converted here.
+    if (config.columnar) {
+        for (size_t i = 0; i + 1 < list.getSize(); ++i) {
+            if (!isColumnar(list.at(i).file)) sealSegment(list.at(i));
+        }
+    }
+    // Sealed segments without a usable zone map or Bloom filters, such as
+    // ones written before either was kept, get them now.
+    for (size_t i = 0; i < list.getSize(); ++i) {
+        const Segment& segment = list.at(i);
+        bool sealed = i + 1 < list.getSize() || segment.rows >= config.tuplesLimit || isColumnar(segment.file);
+        if (sealed && !isSummarized(segment)) summarize(list.at(i));
+    }
+}
+
+// A crash can leave the active segment ending in part of a record, since
+// data files are only synced at checkpoints. Reading it as a row would put
+// its key in the pk index, so the WAL would skip the real row, and the next
+// append would be glued onto it. The segment is cut back to its last
+// complete record before anything reads it.
+void Table::trimTornRecord(Segment& segment) {
+    size_t size = filesystem::file_size(segment.file);
+    size_t complete = 0;
+    if (size > 0) {
+        MappedFile mapped(segment.file);
+        complete = completeLength(mapped.view());
+    }
+    if (complete == size) return;
+    filesystem::resize_file(segment.file, complete);
+    if (complete == 0) {
+        // Not even the header made it.
+        ofstream out(segment.file, ios::app);
+        out << pkColumnName;
+        for (size_t i = 0; i < config.columns.getSize(); ++i) {
+            out << "," << config.columns.at(i);
+        }
+        out << "\n";
+    }
+    syncPath(segment.file);
+    segment.rows = countRows(segment.file);
+    segment.zone.reset();
+    segment.blooms.reset();
+}
+
+// Replaces a sealed CSV segment with its columnar copy. Every row is kept,
+// so ordinals in the N.del bitmap stay valid for the new file.
+void Table::sealSegment(Segment& segment) {
+    filesystem::path target = segment.file;
+    target.replace_extension(COLUMNAR_EXTENSION);
+    filesystem::path tmp = target;
+    tmp += ".tmp";
+    writeColumnar(segment.file, tmp, rowTypes);
+    filesystem::rename(tmp, target);
+    syncPath(config.basePath);
+    segment.handle->pin();
+    filesystem::remove(segment.file);
+    segment.file = target;
+    segment.handle = make_shared<SegmentHandle>(target);
+}
+
+bool Table::isSummarized(const Segment& segment) const {
+    return segment.zone && (bloomColumns.empty() || segment.blooms);
+}
+
+// Writes the zone map and Bloom filters of a sealed segment from every row
+// in the file, deleted or not.
+void Table::summarize(Segment& segment) {
+    Segment whole;
+    whole.file = segment.file;
+    whole.rows = segment.rows;
+    size_t width = getWidth();
+    auto zone = make_shared<ZoneMap>();
+    zone->types = rowTypes;
+    auto blooms = make_shared<SegmentBlooms>(makeBlooms(bloomColumns, segment.rows, config.bloomFalsePositiveRate));
+    Array<string> row = emptyRow(width);
+    SegmentReader reader(whole, width);
+    while (reader.next(row, 0)) {
+        zone->addRow(row, 0);
+        addToBlooms(*blooms, row, 0);
+    }
+    writeFileAtomically(zonePath(segment.file), serializeZoneMap(*zone));
+    segment.zone = std::move(zone);
+    if (bloomColumns.empty()) {
+        filesystem::remove(bloomPath(segment.file));
+    } else {
+        writeFileAtomically(bloomPath(segment.file), serializeBlooms(*blooms));
+        segment.blooms = std::move(blooms);
+    }
+}
+
+// Takes the saved index when it was written for exactly the segments on
+// disk, and rebuilds it from a scan of the pk column otherwise.
+void Table::loadPkIndex() {
+    ifstream f(pkIndexFile, ios::binary);
+    if (f.is_open()) {
+        string data((istreambuf_iterator<char>(f)), istreambuf_iterator<char>());
         try {
-            return stoi(sa) < stoi(sb);
-        } catch (...) {
-            return sa < sb;
+            if (data.compare(0, 8, PK_INDEX_MAGIC) != 0) throw runtime_error("Bad pk index");
+            size_t pos = 8;
+            if (matchesFingerprint(data, pos)) {
+                size_t count = getU64(data, pos);
+                for (size_t i = 0; i < count; ++i) {
+                    string key = getString(data, pos);
+                    RowLocation location;
+                    location.segment = getU64(data, pos);
+                    location.ordinal = getU64(data, pos);
+                    location.offset = getU64(data, pos);
+                    pkIndex->rows.insert(key, location);
+                }
+                return;
+            }
+        } catch (const exception&) {
+            // Rebuilt below.
         }
+    }
+    rebuildPkIndex();
+}
+
+void Table::rebuildPkIndex() {
+    pkIndex->rows = ChainingHashTable<string, RowLocation>();
+    pkIndex->complete = true;
+    pkIndex->dirty = true;
+    Array<size_t> numbers;
+    for (size_t i = 0; i < segments->list.getSize(); ++i) {
+        size_t number = 0;
+        if (!segmentNumber(segments->list.at(i).file, number)) {
+            pkIndex->complete = false;
+            return;
+        }
+        numbers.append(number);
+    }
+    Array<bool> columns;
+    for (size_t c = 0; c < getWidth(); ++c) {
+        columns.append(c == 0);
+    }
+    TableCursor cursor(segments->list, getWidth(), std::move(columns));
+    forEachRow(cursor, [&](const RowBatch& batch, size_t r) {
+        RowLocation location = batch.locations.at(r);
+        location.segment = numbers.at(location.segment);
+        pkIndex->rows.insert(batch.cell(r, 0), location);
     });
-    return files;
 }
 
-size_t Table::getCurrentFileRowCount() const {
-    auto files = getDataFiles();
-    if (files.empty()) return 0;
-    
-    ifstream f(files.at(files.getSize() - 1));
-    size_t lines = 0;
-    string line;
-    while (getline(f, line)) {
-        if (!line.empty()) lines++;
+void Table::savePkIndex() {
+    if (!pkIndex->dirty || !pkIndex->complete) return;
+    string data(PK_INDEX_MAGIC, 8);
+    data += segmentFingerprint();
+    putU64(data, pkIndex->rows.size());
+    pkIndex->rows.forEach([&data](const string& key, const RowLocation& location) {
+        putString(data, key);
+        putU64(data, location.segment);
+        putU64(data, location.ordinal);
+        putU64(data, location.offset);
+    });
+    writeFileAtomically(pkIndexFile, data);
+    pkIndex->dirty = false;
+}
+
+// Number, row count and delete count of every segment. Index files carry
+// it so that one saved before later changes to the data is not trusted.
+string Table::segmentFingerprint() const {
+    const Array<Segment>& list = segments->list;
+    string data;
+    putU64(data, list.getSize());
+    for (size_t i = 0; i < list.getSize(); ++i) {
+        size_t number = 0;
+        segmentNumber(list.at(i).file, number);
+        putU64(data, number);
+        putU64(data, list.at(i).rows);
+        putU64(data, list.at(i).deleted.count());
     }
-    return lines > 0 ? lines - 1 : 0;
+    return data;
 }
 
-filesystem::path Table::getCurrentDataFilePath() const {
-    auto files = getDataFiles();
-    if (files.empty()) return config.basePath / "1.csv";
-    
-    if (getCurrentFileRowCount() >= config.tuplesLimit) {
-        string stem = files.at(files.getSize() - 1).stem().string();
+bool Table::matchesFingerprint(const string& data, size_t& pos) const {
+    const Array<Segment>& list = segments->list;
+    bool matches = getU64(data, pos) == list.getSize();
+    for (size_t i = 0; matches && i < list.getSize(); ++i) {
+        size_t number = 0;
+        matches = segmentNumber(list.at(i).file, number) && getU64(data, pos) == number &&
+                  getU64(data, pos) == list.at(i).rows && getU64(data, pos) == list.at(i).deleted.count();
+    }
+    return matches;
+}
+
+// Slot of a column in the table's rows, 0 for the pk and for unknown names.
+size_t Table::findColumn(const string& column) const {
+    for (size_t i = 0; i < config.columns.getSize(); ++i) {
+        if (config.columns.at(i) == column) return i + 1;
+    }
+    return 0;
+}
+
+Table::SecondaryIndex* Table::findIndex(size_t column) const {
+    for (size_t i = 0; i < indexes->getSize(); ++i) {
+        if (indexes->at(i)->column == column) return indexes->at(i).get();
+    }
+    return nullptr;
+}
+
+bool Table::hasIndex(const ColumnRange& range) const {
+    if (range.column == 0) return range.equality;
+    const SecondaryIndex* index = findIndex(range.column);
+    return index != nullptr && (index->ordered || range.equality);
+}
+
+filesystem::path Table::indexFile(const SecondaryIndex& index) const {
+    string kind = index.ordered ? "_btree_" : "_index_";
+    return config.basePath / (config.name + kind + config.columns.at(index.column - 1));
+}
+
+uint64_t Table::indexTag(const SecondaryIndex& index) const {
+    return hashBytes(ORDERED_KEY_FORMAT + config.columns.at(index.column - 1) +
+                     columnTypeName(rowTypes.at(index.column)) + segmentFingerprint());
+}
+
+void Table::addToIndex(SecondaryIndex& index, const string& value, const string& key) {
+    if (index.ordered) {
+        index.tree->insert(orderedValueKey(rowTypes.at(index.column), value, MAX_ORDERED_VALUE_BYTES) + encodeOrderedKey(key), key);
+    } else {
+        addKey(index.keys, value, key);
+    }
+    index.dirty = true;
+}
+
+void Table::removeFromIndex(SecondaryIndex& index, const string& value, const string& key) {
+    if (index.ordered) {
+        index.tree->remove(orderedValueKey(rowTypes.at(index.column), value, MAX_ORDERED_VALUE_BYTES) + encodeOrderedKey(key));
+    } else {
+        removeKey(index.keys, value, key);
+    }
+    index.dirty = true;
+}
+
+void Table::createIndex(const IndexDefinition& definition) {
+    unique_lock<shared_mutex> guard(*accessLock);
+    const string& column = definition.column;
+    size_t slot = findColumn(column);
+    if (column == pkColumnName) {
+        throw runtime_error("Column " + column + " is the primary key and always indexed");
+    }
+    if (slot == 0) {
+        throw runtime_error("Column " + column + " not found in " + config.name);
+    }
+    if (findIndex(slot) != nullptr) {
+        throw runtime_error("Index on " + config.name + "." + column + " already exists");
+    }
+    lock();
+    try {
+        auto index = make_shared<SecondaryIndex>();
+        index->column = slot;
+        index->ordered = definition.ordered;
+        if (index->ordered) index->tree = make_unique<BTree>(indexFile(*index));
+        rebuildIndex(*index);
+        saveIndex(*index);
+        indexes->append(std::move(index));
+    } catch (...) {
+        unlock();
+        throw;
+    }
+    unlock();
+}
+
+void Table::dropIndex(const string& column) {
+    unique_lock<shared_mutex> guard(*accessLock);
+    size_t slot = findColumn(column);
+    for (size_t i = 0; slot != 0 && i < indexes->getSize(); ++i) {
+        if (indexes->at(i)->column != slot) continue;
+        filesystem::path file = indexFile(*indexes->at(i));
+        indexes->removeAt(i);
+        filesystem::remove(file);
+        return;
+    }
+    throw runtime_error("No index on " + config.name + "." + column);
+}
+
+void Table::loadIndex(SecondaryIndex& index) {
+    if (index.ordered) {
+        if (!index.tree->open(indexTag(index))) rebuildIndex(index);
+        return;
+    }
+    ifstream f(indexFile(index), ios::binary);
+    if (f.is_open()) {
+        string data((istreambuf_iterator<char>(f)), istreambuf_iterator<char>());
         try {
-            int nextNum = stoi(stem) + 1;
-            return config.basePath / (to_string(nextNum) + ".csv");
-        } catch (...) {
-            return config.basePath / "1_new.csv"; 
+            if (data.compare(0, 8, INDEX_MAGIC) != 0) throw runtime_error("Bad index");
+            size_t pos = 8;
+            if (getString(data, pos) == config.columns.at(index.column - 1) && matchesFingerprint(data, pos)) {
+                size_t count = getU64(data, pos);
+                for (size_t i = 0; i < count; ++i) {
+                    string value = getString(data, pos);
+                    Array<string> keys;
+                    size_t keyCount = getU64(data, pos);
+                    for (size_t k = 0; k < keyCount; ++k) {
+                        keys.append(getString(data, pos));
+                    }
+                    index.keys.insert(value, keys);
+                }
+                return;
+            }
+        } catch (const exception&) {
+            // Rebuilt below.
         }
     }
-    return files.at(files.getSize() - 1);
+    rebuildIndex(index);
+}
+
+void Table::rebuildIndex(SecondaryIndex& index) {
+    index.keys = ChainingHashTable<string, Array<string>>();
+    if (index.ordered) index.tree->clear();
+    index.dirty = true;
+    Array<bool> columns;
+    for (size_t c = 0; c < getWidth(); ++c) {
+        columns.append(c == 0 || c == index.column);
+    }
+    TableCursor cursor(segments->list, getWidth(), std::move(columns));
+    forEachRow(cursor, [&](const RowBatch& batch, size_t r) {
+        addToIndex(index, batch.cell(r, index.column), batch.cell(r, 0));
+    });
+}
+
+void Table::saveIndex(SecondaryIndex& index) {
+    if (!index.dirty) return;
+    if (index.ordered) {
+        index.tree->save(indexTag(index));
+        index.dirty = false;
+        return;
+    }
+    string data(INDEX_MAGIC, 8);
+    putString(data, config.columns.at(index.column - 1));
+    data += segmentFingerprint();
+    putU64(data, index.keys.size());
+    index.keys.forEach([&data](const string& value, const Array<string>& keys) {
+        putString(data, value);
+        putU64(data, keys.getSize());
+        for (size_t i = 0; i < keys.getSize(); ++i) {
+            putString(data, keys.at(i));
+        }
+    });
+    writeFileAtomically(indexFile(index), data);
+    index.dirty = false;
 }
 
+// Returns the append stream of the segment the next row goes to, rolling
+// over to a fresh N.csv once the current one holds tuplesLimit rows. A
+// columnar table seals the full segment before starting the next one.
+ofstream& Table::activeSegment() {
+    Array<Segment>& list = segments->list;
+    bool roll = list.empty() || list.at(list.getSize() - 1).rows >= config.tuplesLimit ||
+                isColumnar(list.at(list.getSize() - 1).file);
+    if (!roll && segments->appender.is_open()) return segments->appender;
 
+    filesystem::path file;
+    if (list.empty()) {
+        file = config.basePath / "1.csv";
+    } else if (roll) {
+        string stem = list.at(list.getSize() - 1).file.stem().string();
+        try {
+            file = config.basePath / (to_string(stoi(stem) + 1) + ".csv");
+        } catch (...) {
+            file = config.basePath / "1_new.csv";
+        }
+    } else {
+        file = list.at(list.getSize() - 1).file;
+    }
+
+    segments->appender.close();
+    if (roll && !list.empty()) {
+        Segment& sealed = list.at(list.getSize() - 1);
+        if (config.columnar && !isColumnar(sealed.file)) sealSegment(sealed);
+        if (!isSummarized(sealed)) summarize(sealed);
+    } else if (!roll && (list.at(list.getSize() - 1).zone || list.at(list.getSize() - 1).blooms)) {
+        // Rows appended past the zone map and filters would not be covered
+        // by them.
+        list.at(list.getSize() - 1).zone.reset();
+        list.at(list.getSize() - 1).blooms.reset();
+        filesystem::remove(zonePath(file));
+        filesystem::remove(bloomPath(file));
+    }
+    bool newFile = !filesystem::exists(file);
+    segments->appender.open(file, ios::app);
+    if (!segments->appender) {
+        throw runtime_error("Cannot open " + file.string());
+    }
+    if (newFile) {
+        filesystem::remove(deletedPath(file));
+        string header = pkColumnName;
+        for (size_t i = 0; i < config.columns.getSize(); ++i) {
+            header += "," + config.columns.at(i);
+        }
+        header += "\n";
+        segments->appender << header;
+        segments->appendOffset = header.size();
+    } else {
+        segments->appendOffset = filesystem::file_size(file);
+    }
+    if (roll) {
+        Segment segment;
+        segment.file = file;
+        segment.handle = make_shared<SegmentHandle>(file);
+        list.append(std::move(segment));
+    }
+    return segments->appender;
+}
@@ -0,0 +1,383 @@
+#include "Value.hpp"
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+const char NEGATIVE_TAG = 0x01;
+const char NON_NEGATIVE_TAG = 0x02;
+const char TEXT_TAG = 0x03;
+const size_t MAX_DIGITS = 0xFFFF;
+
+struct Integer {
+    bool negative = false;
+    // Without leading zeros; "0" for zero.
+    string_view digits;
+};
+
+bool parseInteger(string_view value, Integer& out) {
+    size_t pos = 0;
+    out.negative = !value.empty() && value[0] == '-';
+    if (out.negative) pos++;
+    if (pos == value.size()) return false;
+    for (size_t i = pos; i < value.size(); ++i) {
+        if (value[i] < '0' || value[i] > '9') return false;
+    }
+    while (pos + 1 < value.size() && value[pos] == '0') pos++;
+    out.digits = value.substr(pos);
+    if (out.digits == "0") out.negative = false;
+    return out.digits.size() <= MAX_DIGITS;
+}
+
+int compareMagnitude(string_view a, string_view b) {
+    if (a.size() != b.size()) return a.size() < b.size() ? -1 : 1;
+    int result = a.compare(b);
+    return result < 0 ? -1 : (result > 0 ? 1 : 0);
+}
+
+void appendEscaped(string& key, string_view value) {
+    for (char c : value) {
+        key += c;
+        if (c == '\0') key += '\xFF';
+    }
+    key += '\0';
+    key += '\x01';
+}
+
+void appendText(string& key, string_view value) {
+    key += TEXT_TAG;
+    appendEscaped(key, value);
+}
+
+bool parseInt64(string_view value, int64_t& out) {
+    size_t pos = !value.empty() && value[0] == '+' ? 1 : 0;
+    auto result = from_chars(value.data() + pos, value.data() + value.size(), out);
+    return result.ec == errc() && result.ptr == value.data() + value.size()
+        && pos < value.size() && (pos == 0 || value[pos] != '-');
+}
+
+bool parseDouble(string_view value, double& out) {
+    if (value.empty() || isspace(static_cast<unsigned char>(value[0]))) return false;
+    string text(value);
+    char* end = nullptr;
+    out = strtod(text.c_str(), &end);
+    if (end != text.c_str() + text.size() || !isfinite(out)) return false;
+    if (out == 0) out = 0;
+    return true;
+}
+
+bool parseBool(string_view value, bool& out) {
+    string lower;
+    for (char c : value) lower += static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    if (lower == "true" || lower == "t" || lower == "1") {
+        out = true;
+        return true;
+    }
+    if (lower == "false" || lower == "f" || lower == "0") {
+        out = false;
+        return true;
+    }
+    return false;
+}
+
+bool parseDigits(string_view value, size_t pos, size_t count, int& out) {
+    if (pos + count > value.size()) return false;
+    out = 0;
+    for (size_t i = pos; i < pos + count; ++i) {
+        if (value[i] < '0' || value[i] > '9') return false;
+        out = out * 10 + (value[i] - '0');
+    }
+    return true;
+}
+
+int64_t daysFromCivil(int64_t year, int month, int day) {
+    year -= month <= 2;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    int64_t yearOfEra = year - era * 400;
+    int64_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+void civilFromDays(int64_t days, int& year, int& month, int& day) {
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    int64_t dayOfEra = days - era * 146097;
+    int64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    int64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    int64_t shifted = (5 * dayOfYear + 2) / 153;
+    day = static_cast<int>(dayOfYear - (153 * shifted + 2) / 5 + 1);
+    month = static_cast<int>(shifted < 10 ? shifted + 3 : shifted - 9);
+    year = static_cast<int>(yearOfEra + era * 400 + (month <= 2));
+}
+
+// YYYY-MM-DD, optionally followed by ' ' or 'T' and HH:MM:SS.
+bool parseTimestamp(string_view value, int64_t& seconds) {
+    int year, month, day, hour = 0, minute = 0, second = 0;
+    if (value.size() != 10 && value.size() != 19) return false;
+    if (!parseDigits(value, 0, 4, year) || value[4] != '-' || !parseDigits(value, 5, 2, month)
+        || value[7] != '-' || !parseDigits(value, 8, 2, day)) {
+        return false;
+    }
+    if (value.size() == 19) {
+        if ((value[10] != ' ' && value[10] != 'T') || !parseDigits(value, 11, 2, hour) || value[13] != ':'
+            || !parseDigits(value, 14, 2, minute) || value[16] != ':' || !parseDigits(value, 17, 2, second)) {
+            return false;
+        }
+    }
+    static const int DAYS_IN_MONTH[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    bool leap = year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+    if (year < 1 || month < 1 || month > 12 || day < 1
+        || day > DAYS_IN_MONTH[month - 1] + (month == 2 && leap ? 1 : 0)
+        || hour > 23 || minute > 59 || second > 59) {
+        return false;
+    }
+    seconds = daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+    return true;
+}
+
+string formatTimestamp(int64_t seconds) {
+    int64_t days = seconds >= 0 ? seconds / 86400 : -((-seconds + 86399) / 86400);
+    int64_t time = seconds - days * 86400;
+    int year, month, day;
+    civilFromDays(days, year, month, day);
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d %02d:%02d:%02d", year, month, day,
+             static_cast<int>(time / 3600), static_cast<int>(time / 60 % 60), static_cast<int>(time % 60));
+    return buffer;
+}
+
+string formatDouble(double value) {
+    char buffer[32];
+    auto result = to_chars(buffer, buffer + sizeof(buffer), value);
+    return string(buffer, result.ptr);
+}
+
+uint64_t doubleBits(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+void appendUint64(string& out, uint64_t value, bool bigEndian) {
+    for (int b = 0; b < 8; ++b) {
+        int shift = bigEndian ? 8 * (7 - b) : 8 * b;
+        out += static_cast<char>((value >> shift) & 0xFF);
+    }
+}
+
+uint64_t readUint64(const char* data) {
+    uint64_t value = 0;
+    for (int b = 0; b < 8; ++b) {
+        value |= static_cast<uint64_t>(static_cast<unsigned char>(data[b])) << (8 * b);
+    }
+    return value;
+}
+
+}
+
+int compareValues(string_view a, string_view b) {
+    Integer x, y;
+    bool xNumeric = parseInteger(a, x);
+    bool yNumeric = parseInteger(b, y);
+    if (xNumeric && yNumeric) {
+        if (x.negative != y.negative) return x.negative ? -1 : 1;
+        int magnitude = compareMagnitude(x.digits, y.digits);
+        if (magnitude != 0) return x.negative ? -magnitude : magnitude;
+    }
+    if (xNumeric != yNumeric) return xNumeric ? -1 : 1;
+    int result = a.compare(b);
+    return result < 0 ? -1 : (result > 0 ? 1 : 0);
+}
+
+// Integers: a sign tag, the digit count, then the digits, with count and
+// digits inverted for negative numbers so larger magnitudes sort first,
+// then the escaped text as below, which orders '010' before '10'.
+// Text: a tag, the bytes with 0x00 escaped as 0x00 0xFF, then 0x00 0x01.
+string encodeOrderedKey(string_view value) {
+    string key;
+    Integer number;
+    if (parseInteger(value, number)) {
+        size_t length = number.negative ? MAX_DIGITS - number.digits.size() : number.digits.size();
+        key.reserve(number.digits.size() + value.size() + 5);
+        key += number.negative ? NEGATIVE_TAG : NON_NEGATIVE_TAG;
+        key += static_cast<char>((length >> 8) & 0xFF);
+        key += static_cast<char>(length & 0xFF);
+        for (char digit : number.digits) {
+            key += number.negative ? static_cast<char>('0' + '9' - digit) : digit;
+        }
+        appendEscaped(key, value);
+        return key;
+    }
+    key.reserve(value.size() + 3);
+    appendText(key, value);
+    return key;
+}
+
+bool parseColumnType(const string& name, ColumnType& type) {
+    if (name == "int64") type = ColumnType::Int64;
+    else if (name == "double") type = ColumnType::Double;
+    else if (name == "bool") type = ColumnType::Bool;
+    else if (name == "text") type = ColumnType::Text;
+    else if (name == "timestamp") type = ColumnType::Timestamp;
+    else return false;
+    return true;
+}
+
+const char* columnTypeName(ColumnType type) {
+    switch (type) {
+        case ColumnType::Int64: return "int64";
+        case ColumnType::Double: return "double";
+        case ColumnType::Bool: return "bool";
+        case ColumnType::Text: return "text";
+        case ColumnType::Timestamp: return "timestamp";
+        default: return "untyped";
+    }
+}
+
+bool canonicalValue(ColumnType type, string_view value, string& out) {
+    if (value.empty() || type == ColumnType::Untyped || type == ColumnType::Text) {
+        out.assign(value);
+        return true;
+    }
+    switch (type) {
+        case ColumnType::Int64: {
+            int64_t number;
+            if (!parseInt64(value, number)) return false;
+            out = to_string(number);
+            return true;
+        }
+        case ColumnType::Double: {
+            double number;
+            if (!parseDouble(value, number)) return false;
+            out = formatDouble(number);
+            return true;
+        }
+        case ColumnType::Bool: {
+            bool flag;
+            if (!parseBool(value, flag)) return false;
+            out = flag ? "true" : "false";
+            return true;
+        }
+        default: {
+            int64_t seconds;
+            if (!parseTimestamp(value, seconds)) return false;
+            out = formatTimestamp(seconds);
+            return true;
+        }
+    }
+}
+
+// Numeric cells that do not parse, left from before the column was typed,
+// sort after the numbers in compareValues order.
+int compareCells(ColumnType type, string_view a, string_view b) {
+    if (type == ColumnType::Untyped) return compareValues(a, b);
+    if (a.empty() || b.empty()) return a.empty() == b.empty() ? 0 : (a.empty() ? -1 : 1);
+    if (type == ColumnType::Int64) {
+        int64_t x, y;
+        bool xNumeric = parseInt64(a, x);
+        bool yNumeric = parseInt64(b, y);
+        if (xNumeric && yNumeric) return x < y ? -1 : (x > y ? 1 : 0);
+        if (xNumeric != yNumeric) return xNumeric ? -1 : 1;
+        return compareValues(a, b);
+    }
+    if (type == ColumnType::Double) {
+        double x, y;
+        bool xNumeric = parseDouble(a, x);
+        bool yNumeric = parseDouble(b, y);
+        if (xNumeric && yNumeric) return x < y ? -1 : (x > y ? 1 : 0);
+        if (xNumeric != yNumeric) return xNumeric ? -1 : 1;
+        return compareValues(a, b);
+    }
+    int result = a.compare(b);
+    return result < 0 ? -1 : (result > 0 ? 1 : 0);
+}
+
+// Nulls: 0x00. Numbers: 0x01, then eight big-endian bytes ordered like the
+// values. Anything else: 0x02, then its untyped key.
+string encodeOrderedKey(ColumnType type, string_view value) {
+    if (type == ColumnType::Untyped) return encodeOrderedKey(value);
+    string key;
+    if (value.empty()) {
+        key += '\0';
+        return key;
+    }
+    if (type == ColumnType::Int64) {
+        int64_t number;
+        if (parseInt64(value, number)) {
+            key += '\x01';
+            appendUint64(key, static_cast<uint64_t>(number) ^ (uint64_t(1) << 63), true);
+            return key;
+        }
+    } else if (type == ColumnType::Double) {
+        double number;
+        if (parseDouble(value, number)) {
+            uint64_t bits = doubleBits(number);
+            key += '\x01';
+            appendUint64(key, bits >> 63 ? ~bits : bits | (uint64_t(1) << 63), true);
+            return key;
+        }
+    }
+    key += '\x02';
+    key += encodeOrderedKey(value);
+    return key;
+}
+
+size_t binaryWidth(ColumnType type) {
+    switch (type) {
+        case ColumnType::Int64:
+        case ColumnType::Double:
+        case ColumnType::Timestamp:
+            return 8;
+        case ColumnType::Bool:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+bool encodeBinary(ColumnType type, string_view value, string& out) {
+    string canonical;
+    if (value.empty() || binaryWidth(type) == 0 || !canonicalValue(type, value, canonical) || canonical != value) {
+        return false;
+    }
+    if (type == ColumnType::Bool) {
+        out += value == "true" ? '\x01' : '\0';
+        return true;
+    }
+    int64_t number = 0;
+    double real = 0;
+    if (type == ColumnType::Int64) {
+        parseInt64(value, number);
+        appendUint64(out, static_cast<uint64_t>(number), false);
+    } else if (type == ColumnType::Double) {
+        parseDouble(value, real);
+        appendUint64(out, doubleBits(real), false);
+    } else {
+        parseTimestamp(value, number);
+        appendUint64(out, static_cast<uint64_t>(number), false);
+    }
+    return true;
+}
+
+void decodeBinary(ColumnType type, const char* data, string& out) {
+    if (type == ColumnType::Bool) {
+        out = *data ? "true" : "false";
+        return;
+    }
+    uint64_t bits = readUint64(data);
+    if (type == ColumnType::Int64) {
+        out = to_string(static_cast<int64_t>(bits));
+    } else if (type == ColumnType::Double) {
+        double real;
+        memcpy(&real, &bits, sizeof(real));
+        out = formatDouble(real);
+    } else {
+        out = formatTimestamp(static_cast<int64_t>(bits));
+    }
+}
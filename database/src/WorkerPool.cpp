@@ -0,0 +1,47 @@
+#include "WorkerPool.hpp"
+#include <iostream>
+
+
+WorkerPool::WorkerPool(size_t threads, size_t maxQueued) : maxQueued(maxQueued) {
+    for (size_t i = 0; i < threads; ++i) {
+        workers.append(thread(&WorkerPool::workerLoop, this));
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        lock_guard<mutex> lock(mtx);
+        stopping = true;
+    }
+    available.notify_all();
+    for (size_t i = 0; i < workers.getSize(); ++i) {
+        if (workers.at(i).joinable()) workers.at(i).join();
+    }
+}
+
+bool WorkerPool::tryPost(function<void()> task) {
+    {
+        lock_guard<mutex> lock(mtx);
+        if (stopping || tasks.getSize() >= maxQueued) return false;
+        tasks.push(std::move(task));
+    }
+    available.notify_one();
+    return true;
+}
+
+void WorkerPool::workerLoop() {
+    while (true) {
+        function<void()> task;
+        {
+            unique_lock<mutex> lock(mtx);
+            available.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (tasks.empty()) return;
+            task = tasks.pop();
+        }
+        try {
+            task();
+        } catch (const exception& e) {
+            cerr << "Ошибка: " << e.what() << "\n";
+        }
+    }
+}
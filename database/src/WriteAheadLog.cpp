@@ -0,0 +1,249 @@
+#include "WriteAheadLog.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+
+namespace {
+
+const size_t RECORD_HEADER_SIZE = 8;
+
+uint32_t crc32(const char* data, size_t length) {
+    static uint32_t table[256];
+    static bool initialized = [] {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+        return true;
+    }();
+    (void)initialized;
+
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < length; ++i) {
+        crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+void putU32(string& out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out += static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+}
+
+uint32_t getU32(const char* data) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+        value |= static_cast<uint32_t>(static_cast<unsigned char>(data[i])) << (8 * i);
+    }
+    return value;
+}
+
+void putString(string& out, const string& value) {
+    putU32(out, static_cast<uint32_t>(value.size()));
+    out += value;
+}
+
+class Reader {
+public:
+    Reader(const string& data) : data(data) {}
+
+    uint32_t u32() {
+        need(4);
+        uint32_t value = getU32(data.data() + pos);
+        pos += 4;
+        return value;
+    }
+
+    string str() {
+        size_t length = u32();
+        need(length);
+        string value = data.substr(pos, length);
+        pos += length;
+        return value;
+    }
+
+    char byte() {
+        need(1);
+        return data[pos++];
+    }
+
+private:
+    void need(size_t n) {
+        if (data.size() - pos < n) throw runtime_error("Truncated WAL record");
+    }
+
+    const string& data;
+    size_t pos = 0;
+};
+
+string encodeRecord(const WalRecord& record) {
+    string payload;
+    payload += static_cast<char>(record.kind);
+    putString(payload, record.table);
+    if (record.kind == WalRecord::Kind::Insert) {
+        putU32(payload, static_cast<uint32_t>(record.rows.getSize()));
+        for (size_t i = 0; i < record.rows.getSize(); ++i) {
+            const Array<string>& row = record.rows.at(i);
+            putU32(payload, static_cast<uint32_t>(row.getSize()));
+            for (size_t c = 0; c < row.getSize(); ++c) {
+                putString(payload, row.at(c));
+            }
+        }
+    } else {
+        putU32(payload, static_cast<uint32_t>(record.keys.getSize()));
+        for (size_t i = 0; i < record.keys.getSize(); ++i) {
+            putString(payload, record.keys.at(i));
+        }
+    }
+
+    string framed;
+    framed.reserve(RECORD_HEADER_SIZE + payload.size());
+    putU32(framed, static_cast<uint32_t>(payload.size()));
+    putU32(framed, crc32(payload.data(), payload.size()));
+    framed += payload;
+    return framed;
+}
+
+WalRecord decodeRecord(const string& payload) {
+    Reader in(payload);
+    WalRecord record;
+    char kind = in.byte();
+    if (kind != static_cast<char>(WalRecord::Kind::Insert) && kind != static_cast<char>(WalRecord::Kind::Delete)) {
+        throw runtime_error("Unknown WAL record");
+    }
+    record.kind = static_cast<WalRecord::Kind>(kind);
+    record.table = in.str();
+    size_t count = in.u32();
+    for (size_t i = 0; i < count; ++i) {
+        if (record.kind == WalRecord::Kind::Insert) {
+            Array<string> row;
+            size_t width = in.u32();
+            for (size_t c = 0; c < width; ++c) {
+                row.append(in.str());
+            }
+            record.rows.append(std::move(row));
+        } else {
+            record.keys.append(in.str());
+        }
+    }
+    return record;
+}
+
+}
+
+WalSyncMode parseWalSyncMode(const string& name) {
+    if (name == "always") return WalSyncMode::Always;
+    if (name == "interval") return WalSyncMode::Interval;
+    if (name == "os") return WalSyncMode::Os;
+    throw runtime_error("Unknown wal_sync mode: " + name);
+}
+
+WriteAheadLog::WriteAheadLog(const filesystem::path& path, WalSyncMode mode, size_t intervalMs)
+    : path(path.string()), mode(mode), interval(intervalMs) {
+    fd = open(this->path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw runtime_error("Cannot open " + this->path + ": " + strerror(errno));
+    }
+    off_t end = lseek(fd, 0, SEEK_END);
+    size = end > 0 ? static_cast<size_t>(end) : 0;
+    if (mode == WalSyncMode::Interval) {
+        syncer = thread(&WriteAheadLog::syncLoop, this);
+    }
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    {
+        lock_guard<mutex> lock(mtx);
+        stopping = true;
+    }
+    stopSignal.notify_all();
+    if (syncer.joinable()) syncer.join();
+    if (fd >= 0) {
+        if (mode != WalSyncMode::Os) fdatasync(fd);
+        close(fd);
+    }
+}
+
+void WriteAheadLog::append(const WalRecord& record) {
+    string data = encodeRecord(record);
+    lock_guard<mutex> lock(mtx);
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw runtime_error("WAL write failed: " + string(strerror(errno)));
+        }
+        written += static_cast<size_t>(n);
+    }
+    size += data.size();
+    if (mode == WalSyncMode::Always) {
+        if (fdatasync(fd) != 0) {
+            throw runtime_error("WAL sync failed: " + string(strerror(errno)));
+        }
+    } else {
+        dirty = true;
+    }
+}
+
+Array<WalRecord> WriteAheadLog::readAll() const {
+    lock_guard<mutex> lock(mtx);
+    string data(size, '\0');
+    size_t loaded = 0;
+    while (loaded < size) {
+        ssize_t n = pread(fd, &data[loaded], size - loaded, static_cast<off_t>(loaded));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        loaded += static_cast<size_t>(n);
+    }
+
+    Array<WalRecord> records;
+    size_t pos = 0;
+    while (loaded - pos >= RECORD_HEADER_SIZE) {
+        size_t length = getU32(data.data() + pos);
+        uint32_t checksum = getU32(data.data() + pos + 4);
+        if (loaded - pos - RECORD_HEADER_SIZE < length) break;
+        string payload = data.substr(pos + RECORD_HEADER_SIZE, length);
+        if (crc32(payload.data(), payload.size()) != checksum) break;
+        try {
+            records.append(decodeRecord(payload));
+        } catch (const exception&) {
+            break;
+        }
+        pos += RECORD_HEADER_SIZE + length;
+    }
+    return records;
+}
+
+void WriteAheadLog::truncate() {
+    lock_guard<mutex> lock(mtx);
+    if (ftruncate(fd, 0) != 0 || fsync(fd) != 0) {
+        throw runtime_error("WAL truncate failed: " + string(strerror(errno)));
+    }
+    size = 0;
+    dirty = false;
+}
+
+size_t WriteAheadLog::getSize() const {
+    lock_guard<mutex> lock(mtx);
+    return size;
+}
+
+void WriteAheadLog::syncLoop() {
+    unique_lock<mutex> lock(mtx);
+    while (!stopping) {
+        stopSignal.wait_for(lock, interval);
+        if (!dirty) continue;
+        dirty = false;
+        lock.unlock();
+        fdatasync(fd);
+        lock.lock();
+    }
+}
@@ -0,0 +1,204 @@
+#include "Database.hpp"
+#include "Executor.hpp"
+#include "Query.hpp"
+#include "Csv.hpp"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+// Every heap allocation in the process goes through here so a run can report
+// how many allocations the SELECT row path performs per scanned row.
+static atomic<size_t> g_allocations{0};
+
+void* operator new(size_t size) {
+    g_allocations++;
+    void* p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr) throw bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+class NullBuffer : public streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    streamsize xsputn(const char*, streamsize n) override { return n; }
+};
+
+struct BenchResult {
+    size_t allocations;
+    double seconds;
+};
+
+void writeTable(const filesystem::path& dir, size_t rows, size_t tuplesLimit) {
+    filesystem::remove_all(dir);
+    filesystem::create_directories(dir);
+    ofstream f;
+    for (size_t id = 1; id <= rows; ++id) {
+        if ((id - 1) % tuplesLimit == 0) {
+            f.close();
+            f.open(dir / (to_string((id - 1) / tuplesLimit + 1) + ".csv"));
+            f << "bench_pk,a,b,c\n";
+        }
+        f << id << "," << (id % 97) << ",value" << (id % 1013) << ",const\n";
+    }
+}
+
+// Baseline: the hash-table row format SELECT used before the slot layout.
+void legacyRowMapScan(const filesystem::path& dir, const Array<string>& columns) {
+    for (const auto& entry : filesystem::directory_iterator(dir)) {
+        if (entry.path().extension() != ".csv") continue;
+        ifstream f(entry.path());
+        string line;
+        bool header = true;
+        while (getline(f, line)) {
+            if (header) {
+                header = false;
+                continue;
+            }
+            Array<string> row;
+            stringstream ss(line);
+            string cell;
+            while (getline(ss, cell, ',')) {
+                row.append(cell);
+            }
+            ChainingHashTable<string, string> rowMap;
+            rowMap.insert("bench_pk", row.at(0));
+            for (size_t i = 0; i < columns.getSize() && i + 1 < row.getSize(); ++i) {
+                rowMap.insert("bench." + columns.at(i), row.at(i + 1));
+                rowMap.insert(columns.at(i), row.at(i + 1));
+            }
+            ChainingHashTable<string, string> combined;
+            combined = rowMap;
+        }
+    }
+}
+
+// Segment-like CSV text of about the given size; every fourth record has a
+// quoted field with an embedded separator.
+string makeCsvBuffer(size_t bytes) {
+    string text;
+    text.reserve(bytes + 64);
+    for (size_t id = 1; text.size() < bytes; ++id) {
+        text += to_string(id);
+        text += ",";
+        text += to_string(id % 97);
+        text += id % 4 == 0 ? ",\"value, " : ",value";
+        text += to_string(id % 1013);
+        text += id % 4 == 0 ? "\",const\n" : ",const\n";
+    }
+    return text;
+}
+
+// Baseline: the line-then-stringstream split segments were parsed with.
+size_t stringstreamSplit(const string& text) {
+    istringstream in(text);
+    string line;
+    size_t cells = 0;
+    while (getline(in, line)) {
+        stringstream ss(line);
+        string cell;
+        while (getline(ss, cell, ',')) {
+            cells++;
+        }
+    }
+    return cells;
+}
+
+size_t tokenizerSplit(const string& text) {
+    CsvCursor cursor(text);
+    Array<string> row;
+    for (int c = 0; c < 4; ++c) {
+        row.append(string());
+    }
+    size_t records = 0;
+    while (cursor.next(row, 0, 4)) {
+        records++;
+    }
+    return records;
+}
+
+size_t structuralScan(const string& text) {
+    size_t hits = 0;
+    for (size_t i = 0; i < text.size(); i += 64) {
+        hits += __builtin_popcountll(findCsvSpecials(text.data() + i, text.size() - i));
+    }
+    return hits;
+}
+
+template <typename F>
+BenchResult measure(F&& body) {
+    size_t before = g_allocations.load();
+    auto start = chrono::steady_clock::now();
+    body();
+    auto end = chrono::steady_clock::now();
+    return { g_allocations.load() - before, chrono::duration<double>(end - start).count() };
+}
+
+void report(const string& name, const BenchResult& small, const BenchResult& large, size_t rows) {
+    double perRow = static_cast<double>(large.allocations - small.allocations) / rows;
+    cout << name << ": " << perRow << " allocations/row, "
+         << (rows * 2 / large.seconds / 1e6) << " M rows/s\n";
+}
+
+int main(int argc, char* argv[]) {
+    size_t rows = argc > 1 ? stoul(argv[1]) : 200000;
+    filesystem::path root = filesystem::temp_directory_path() / "database-bench";
+    filesystem::remove_all(root);
+
+    Schema schema;
+    schema.name = root.string();
+    schema.tuplesLimit = 1000;
+    Array<string> columns;
+    columns.append("a");
+    columns.append("b");
+    columns.append("c");
+    schema.structure.insert("bench", columns);
+
+    NullBuffer nullBuffer;
+    ostream sink(&nullBuffer);
+    auto select = tokenize("SELECT bench_pk, b FROM bench WHERE a = '5' OR c = 'none'");
+
+    BenchResult results[2][2];
+    size_t counts[2] = { rows, rows * 2 };
+    for (int run = 0; run < 2; ++run) {
+        // Tables list their segments when opened, so open after writing.
+        writeTable(root / "bench", counts[run], schema.tuplesLimit);
+        Database db(schema);
+        results[0][run] = measure([&] { legacyRowMapScan(root / "bench", columns); });
+        results[1][run] = measure([&] { executeSelect(select, db, sink); });
+    }
+
+    cout << "rows: " << rows << " vs " << rows * 2 << "\n";
+    report("row map (baseline)", results[0][0], results[0][1], rows);
+    report("slot rows (SELECT)", results[1][0], results[1][1], rows);
+
+    const size_t csvBytes = 64 * 1024 * 1024;
+    string csv = makeCsvBuffer(csvBytes);
+    size_t checksum = 0;
+    BenchResult split[3] = {
+        measure([&] { checksum += stringstreamSplit(csv); }),
+        measure([&] { checksum += tokenizerSplit(csv); }),
+        measure([&] { checksum += structuralScan(csv); }),
+    };
+    const char* names[3] = { "stringstream split (baseline)", "csv tokenizer", "structural scan" };
+    for (int i = 0; i < 3; ++i) {
+        cout << names[i] << ": " << (csv.size() / split[i].seconds / 1e9) << " GB/s\n";
+    }
+    if (checksum == 0) cout << "\n";
+
+    filesystem::remove_all(root);
+    return 0;
+}
@@ -5,6 +5,7 @@
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <cstring>
+#include "Protocol.hpp"
 
 using namespace std;
 
@@ -26,11 +27,25 @@ int main() {
         return 1;
     }
     
+    char handshake[FRAME_HANDSHAKE_SIZE];
+    size_t received = 0;
+    sendAll(clientSocket, FRAME_HANDSHAKE, FRAME_HANDSHAKE_SIZE);
+    while (received < FRAME_HANDSHAKE_SIZE) {
+        ssize_t n = recv(clientSocket, handshake + received, FRAME_HANDSHAKE_SIZE - received, 0);
+        if (n <= 0) break;
+        received += static_cast<size_t>(n);
+    }
+    if (received < FRAME_HANDSHAKE_SIZE || memcmp(handshake, FRAME_HANDSHAKE, FRAME_HANDSHAKE_SIZE) != 0) {
+        cerr << "сервер не поддерживает протокол\n";
+        close(clientSocket);
+        return 1;
+    }
+    
     cout << "подключено к серверу на порту 7432\n";
     cout << "'quit' отключиться\n\n";
     
+    FrameReader reader(clientSocket);
     string query;
-    char buffer[4096];
     
     while (true) {
         cout << "db> ";
@@ -38,17 +53,34 @@ int main() {
         
         if (query.empty()) continue;
         
-        send(clientSocket, query.c_str(), query.length(), 0);
-        
-        memset(buffer, 0, sizeof(buffer));
-        ssize_t bytesReceived = recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
+        if (!sendFrame(clientSocket, FrameType::Query, query)) {
+            cerr << "соединение потеряно\n";
+            break;
+        }
         
-        if (bytesReceived > 0) {
-            cout << buffer;
-            if (string(buffer).find("пока") != string::npos) {
+        // The server answers quit and then closes the connection; trailing
+        // whitespace is ignored the same way it is there.
+        bool quit = query.substr(0, query.find_last_not_of(" \r\t") + 1) == "quit";
+        bool connected = true;
+        Frame frame;
+        while (true) {
+            if (!reader.next(frame)) {
+                connected = false;
+                break;
+            }
+            if (frame.type == FrameType::Data) {
+                cout << frame.payload;
+            } else if (frame.type == FrameType::Complete) {
                 break;
             }
         }
+        cout.flush();
+        
+        if (!connected) {
+            cerr << "соединение потеряно\n";
+            break;
+        }
+        if (quit) break;
     }
     
     close(clientSocket);
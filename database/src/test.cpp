@@ -0,0 +1,314 @@
+#include "Database.hpp"
+#include "Executor.hpp"
+#include "Query.hpp"
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <iterator>
+
+using namespace std;
+
+// Storage scenarios that are hard to reach from the console: files left
+// behind by a crash, schema changes between runs. Each test builds its
+// database under a scratch directory and checks what a later open sees.
+
+static size_t g_failures = 0;
+
+void check(bool condition, const string& message) {
+    if (condition) return;
+    cout << "FAIL: " << message << "\n";
+    g_failures++;
+}
+
+string run(Database& db, const string& query) {
+    ostringstream out;
+    Array<string> tokens = tokenize(query);
+    if (tokens.at(0) == "SELECT") {
+        executeSelect(tokens, db, out);
+    } else if (tokens.at(0) == "INSERT") {
+        executeInsert(tokens, db, out);
+    } else {
+        executeDelete(tokens, db, out);
+    }
+    return out.str();
+}
+
+Schema makeSchema(const filesystem::path& dir, size_t tuplesLimit) {
+    Schema schema;
+    schema.name = dir.string();
+    schema.tuplesLimit = tuplesLimit;
+    Array<string> columns;
+    columns.append("a");
+    columns.append("b");
+    schema.structure.insert("t", columns);
+    return schema;
+}
+
+string readFile(const filesystem::path& path) {
+    ifstream in(path, ios::binary);
+    return string((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+}
+
+// A crash after the WAL is synced but before the data file is leaves the
+// active segment ending mid-record, possibly inside a quoted field. Opening
+// the copy must replay the torn row whole and keep new rows separate.
+void testTornTail(const filesystem::path& root) {
+    filesystem::path live = root / "torn";
+    filesystem::path crashed = root / "torn-crashed";
+    {
+        Database db(makeSchema(live, 1000));
+        run(db, "INSERT INTO t VALUES ('1', 'one')");
+        run(db, "INSERT INTO t VALUES ('2', 'two')");
+        run(db, "INSERT INTO t VALUES ('3', 'line,\nbreak')");
+        filesystem::copy(live, crashed, filesystem::copy_options::recursive);
+    }
+
+    filesystem::path segment = crashed / "t" / "1.csv";
+    string data = readFile(segment);
+    size_t cut = data.rfind('\n', data.size() - 2);
+    check(cut != string::npos && data.compare(cut - 6, 6, "\"line,") == 0, "quoted row spans two lines");
+    filesystem::resize_file(segment, cut + 1);
+
+    Database db(makeSchema(crashed, 1000));
+    string rows = run(db, "SELECT t.t_pk, t.a, t.b FROM t");
+    check(rows == "1,1,one\n2,2,two\n3,3,\"line,\nbreak\"\n", "torn row replayed from the WAL, got:\n" + rows);
+    run(db, "INSERT INTO t VALUES ('4', 'four')");
+    rows = run(db, "SELECT t.a, t.b FROM t WHERE t.t_pk > '3'");
+    check(rows == "4,four\n", "row after recovery stored separately, got:\n" + rows);
+}
+
+Array<string> lines(const string& text) {
+    Array<string> result;
+    istringstream in(text);
+    string line;
+    while (getline(in, line)) result.append(line);
+    return result;
+}
+
+// Segments written under a larger tuples_limit than the current one can
+// hold more live rows than fit back into as many segments. Compaction has
+// to number the extra outputs itself and keep appending after them.
+void testCompactAfterLoweringLimit(const filesystem::path& root, const string& storage) {
+    filesystem::path dir = root / ("lowered-" + storage);
+    {
+        Schema schema = makeSchema(dir, 100);
+        schema.walSync = "os";
+        schema.storage = storage;
+        Database db(schema);
+        for (size_t i = 1; i <= 250; ++i) {
+            run(db, "INSERT INTO t VALUES ('" + to_string(i) + "', 'x')");
+        }
+        run(db, "DELETE FROM t WHERE t.a <= '30' OR t.a BETWEEN '101' AND '130'");
+    }
+
+    Schema schema = makeSchema(dir, 20);
+    schema.walSync = "os";
+    schema.storage = storage;
+    {
+        Database db(schema);
+        CompactionStats stats = db.getTable("t").compact(0);
+        check(stats.segmentsMerged == 2 && stats.segmentsWritten == 7,
+              "compaction split 2 segments into 7, got " + to_string(stats.segmentsMerged) + " into " +
+              to_string(stats.segmentsWritten));
+        run(db, "INSERT INTO t VALUES ('251', 'x')");
+        Array<string> rows = lines(run(db, "SELECT t.a FROM t"));
+        check(rows.getSize() == 191, "live rows kept after compaction, got " + to_string(rows.getSize()));
+    }
+
+    Database db(schema);
+    Array<string> rows = lines(run(db, "SELECT t.a FROM t"));
+    ChainingHashTable<string, bool> seen;
+    bool complete = rows.getSize() == 191;
+    for (size_t i = 0; i < rows.getSize(); ++i) {
+        if (seen.find(rows.at(i))) complete = false;
+        seen.insert(rows.at(i), true);
+    }
+    for (size_t i = 31; i <= 251; ++i) {
+        if (i > 100 && i <= 130) continue;
+        if (!seen.find(to_string(i))) complete = false;
+    }
+    check(complete, "every live row once after reopening, got " + to_string(rows.getSize()) + " rows");
+}
+
+// A columnar segment whose cell offsets point past their block, as a torn
+// or corrupted file may, has to fail the query instead of reading outside
+// the mapping.
+void testCorruptCellOffsets(const filesystem::path& root) {
+    filesystem::path dir = root / "corrupt-offsets";
+    Schema schema = makeSchema(dir, 10);
+    schema.storage = "columnar";
+    {
+        Database db(schema);
+        for (size_t i = 1; i <= 15; ++i) {
+            run(db, "INSERT INTO t VALUES ('" + to_string(i) + "', 'x')");
+        }
+    }
+
+    filesystem::path segment = dir / "t" / "1.col";
+    string data = readFile(segment);
+    const size_t footer = 20, entry = 24, width = 3;
+    size_t directory = data.size() - footer - width * entry;
+    size_t block = 0;
+    for (int i = 0; i < 8; ++i) {
+        block |= static_cast<size_t>(static_cast<unsigned char>(data[directory + entry + i])) << (8 * i);
+    }
+    for (size_t i = 0; i < 4; ++i) {
+        data[block + 4 + i] = '\xF0';
+    }
+    ofstream(segment, ios::binary | ios::trunc) << data;
+
+    Database db(schema);
+    string rows = run(db, "SELECT t.a FROM t");
+    check(rows.find("Error: Corrupt columnar segment") != string::npos,
+          "corrupt offsets fail the scan, got:\n" + rows.substr(0, 200));
+}
+
+// Segments whose rows are all deleted compact to nothing: they are removed
+// and the rows after them stay.
+void testCompactAllDeleted(const filesystem::path& root) {
+    filesystem::path dir = root / "all-deleted";
+    Schema schema = makeSchema(dir, 10);
+    schema.walSync = "os";
+    {
+        Database db(schema);
+        for (size_t i = 1; i <= 35; ++i) {
+            run(db, "INSERT INTO t VALUES ('" + to_string(i) + "', 'x')");
+        }
+        run(db, "DELETE FROM t WHERE t.a <= '20'");
+        CompactionStats stats = db.getTable("t").compact(0);
+        check(stats.segmentsMerged == 2 && stats.segmentsWritten == 0,
+              "two emptied segments compact to none, got " + to_string(stats.segmentsMerged) + " into " +
+              to_string(stats.segmentsWritten));
+    }
+    Database db(schema);
+    Array<string> rows = lines(run(db, "SELECT t.a FROM t"));
+    check(rows.getSize() == 15 && rows.at(0) == "21", "rows after the emptied segments kept, got " +
+          to_string(rows.getSize()));
+}
+
+// A SELECT reads its cursor after dropping the table lock, so compaction
+// can rename its outputs over the files the cursor has yet to reach. The
+// cursor must still read the rows it was opened on, each once.
+void testCursorOutlivesCompaction(const filesystem::path& root, const string& storage) {
+    Schema schema = makeSchema(root / ("cursor-" + storage), 10);
+    schema.walSync = "os";
+    schema.storage = storage;
+    Database db(schema);
+    for (size_t i = 1; i <= 95; ++i) {
+        run(db, "INSERT INTO t VALUES ('" + to_string(i) + "', '" + (i % 3 == 0 ? "y" : "x") + "')");
+    }
+    run(db, "DELETE FROM t WHERE t.b = 'y'");
+    Table& table = db.getTable("t");
+    TableCursor cursor = [&table]() {
+        shared_lock<shared_mutex> guard = table.lockForRead();
+        return table.openScan();
+    }();
+    CompactionStats stats = table.compact(0);
+    check(stats.segmentsMerged > 0, storage + ": compaction merged segments under the cursor");
+    run(db, "INSERT INTO t VALUES ('96', 'x')");
+
+    RowBatch batch;
+    ChainingHashTable<string, bool> seen;
+    size_t rows = 0;
+    bool exact = true;
+    while (cursor.nextBatch(batch)) {
+        for (size_t r = 0; r < batch.rows; ++r) {
+            const string& a = batch.cell(r, 1);
+            if (seen.find(a) || stoul(a) % 3 == 0 || stoul(a) > 95) exact = false;
+            seen.insert(a, true);
+            rows++;
+        }
+    }
+    check(exact && rows == 64, storage + ": cursor reads the rows it was opened on, got " + to_string(rows));
+}
+
+// `=` is exact, so '010' is not '10' in an untyped column even though both
+// are the number 10. Ranges order such cells by their text after their
+// value, so BETWEEN '10' AND '10' agrees with `=` whether the rows come
+// from a scan past Bloom filters, a hash index or a B+tree.
+void testNumericEquality(const filesystem::path& root, const string& index) {
+    Schema schema = makeSchema(root / ("equality-" + index), 2);
+    Array<string> bloomColumns;
+    bloomColumns.append("a");
+    schema.bloomFilters.insert("t", bloomColumns);
+    Database db(schema);
+    const char* values[] = {"010", "10", "7", "-0", "x", "0"};
+    for (const char* value : values) {
+        run(db, "INSERT INTO t VALUES ('" + string(value) + "', 'v')");
+    }
+    if (index != "none") {
+        IndexDefinition definition;
+        definition.column = "a";
+        definition.ordered = index == "btree";
+        db.createIndex("t", definition);
+    }
+    string equal = run(db, "SELECT t.a FROM t WHERE t.a = '10'");
+    string between = run(db, "SELECT t.a FROM t WHERE t.a BETWEEN '10' AND '10'");
+    check(equal == "10\n", index + ": '10' is an exact match, got:\n" + equal);
+    check(equal == between, index + ": = and BETWEEN agree, got:\n" + between);
+    string zero = run(db, "SELECT t.a FROM t WHERE '-0' = t.a");
+    check(zero == "-0\n", index + ": '-0' is not '0', got:\n" + zero);
+    string range = run(db, "SELECT t.a FROM t WHERE t.a BETWEEN '0' AND '10'");
+    check(range == "010\n10\n7\n0\n", index + ": '-0' sorts before '0', got:\n" + range);
+}
+
+// An empty cell is null and lies in no range, whatever the column's type,
+// so a range on it has to skip the same rows through the zone maps and a
+// B+tree as through the filters, while `= ''` still finds them.
+void testNullsOutsideRanges(const filesystem::path& root, bool indexed) {
+    Schema schema = makeSchema(root / (indexed ? "nulls-btree" : "nulls"), 2);
+    Array<ColumnType> types;
+    types.append(ColumnType::Untyped);
+    types.append(ColumnType::Double);
+    schema.columnTypes.insert("t", types);
+    Database db(schema);
+    run(db, "INSERT INTO t VALUES ('5', '')");
+    run(db, "INSERT INTO t VALUES ('', '1.5')");
+    run(db, "INSERT INTO t VALUES ('7', '2')");
+    run(db, "INSERT INTO t VALUES ('', '')");
+    run(db, "INSERT INTO t VALUES ('x', '0.5')");
+    if (indexed) {
+        IndexDefinition definition;
+        definition.ordered = true;
+        definition.column = "a";
+        db.createIndex("t", definition);
+        definition.column = "b";
+        db.createIndex("t", definition);
+    }
+    string mode = indexed ? "btree" : "scan";
+    string rows = run(db, "SELECT t.a, t.b FROM t WHERE t.b < '1.6'");
+    check(rows == ",1.5\nx,0.5\n", mode + ": double range skips nulls, got:\n" + rows);
+    rows = run(db, "SELECT t.a, t.b FROM t WHERE t.a > '5'");
+    check(rows == "7,2\nx,0.5\n", mode + ": untyped range skips nulls, got:\n" + rows);
+    rows = run(db, "SELECT t.a FROM t WHERE t.a >= ''");
+    check(rows.empty(), mode + ": empty bound matches nothing, got:\n" + rows);
+    rows = run(db, "SELECT t.a, t.b FROM t WHERE t.b = ''");
+    check(rows == "5,\n,\n", mode + ": = '' finds nulls, got:\n" + rows);
+}
+
+int main() {
+    filesystem::path root = filesystem::temp_directory_path() / "database-test";
+    filesystem::remove_all(root);
+    filesystem::create_directories(root);
+
+    testTornTail(root);
+    testCompactAfterLoweringLimit(root, "csv");
+    testCompactAfterLoweringLimit(root, "columnar");
+    testCompactAllDeleted(root);
+    testCorruptCellOffsets(root);
+    testCursorOutlivesCompaction(root, "csv");
+    testCursorOutlivesCompaction(root, "columnar");
+    testNumericEquality(root, "none");
+    testNumericEquality(root, "hash");
+    testNumericEquality(root, "btree");
+    testNullsOutsideRanges(root, false);
+    testNullsOutsideRanges(root, true);
+
+    filesystem::remove_all(root);
+    if (g_failures > 0) {
+        cout << g_failures << " failed\n";
+        return 1;
+    }
+    cout << "All tests passed\n";
+    return 0;
+}